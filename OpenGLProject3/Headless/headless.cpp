@@ -0,0 +1,403 @@
+// Headless batch runner: builds the solar system without any GL, advances it
+// as fast as possible and reports throughput and energy drift.
+//
+// Only needs glm (header-only) besides the project headers, so it also builds
+// on machines without a GPU, e.g.
+//   g++ -O2 -std=c++20 -pthread -I../OpenGLProject3/header headless.cpp -o headless
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <BodySystem.h>
+#include <SolarSystem.h>
+#include <IntegratorFactory.h>
+#include <Checkpoint.h>
+#include <ConservationMonitor.h>
+#include <Ensemble.h>
+#include <BodyCatalog.h>
+#include <HorizonsImport.h>
+#include <fstream>
+#include <sstream>
+
+// Integrate members copies of the system, seeded seed, seed + 1, ..., in one
+// ensemble and print the spread of the results
+int runEnsemble(size_t members, unsigned int seed, const BodyCatalog& catalog, size_t asteroidCount, double years, double substepDays,
+	ThreadPool& pool, const std::string& csvPath) {
+	std::vector<unsigned int> seeds(members);
+	for (size_t m = 0; m < members; m++) seeds[m] = seed + static_cast<unsigned int>(m);
+
+	EnsembleSystem ensemble;
+	ensemble.pool = &pool;
+	if (!ensemble.build(seeds, [&](BodySystem& bodies) {
+		catalog.addBodies(bodies);
+		addAsteroidBelt(bodies, asteroidCount);
+	})) {
+		std::cerr << "Ensemble members differ in size" << std::endl;
+		return 1;
+	}
+
+	std::vector<double> startEnergies;
+	ensemble.energies(startEnergies);
+
+	std::cout << "ensemble of " << members << " members, " << ensemble.bodyCount << " bodies each"
+		<< ", verlet, substep " << substepDays << " days"
+		<< ", " << pool.threadCount() << " threads" << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	ensemble.advance(Years(years), Days(substepDays));
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	unsigned long long steps = static_cast<unsigned long long>(std::ceil(Years(years) / Days(substepDays)));
+	double bodySteps = static_cast<double>(steps) * ensemble.bodyCount * members;
+
+	EnsembleReport report(ensemble, startEnergies);
+	std::cout << "steps              " << steps << std::endl;
+	std::cout << "wall time          " << seconds << " s" << std::endl;
+	std::cout << "body-steps/s       " << std::scientific << std::setprecision(3) << bodySteps / seconds << std::defaultfloat << std::endl;
+	report.writeSummary(std::cout);
+
+	if (!csvPath.empty()) {
+		std::ofstream csv(csvPath);
+		report.writeCSV(csv);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	double years = 10.0;
+	IntegratorType integratorType = IntegratorType::VelocityVerlet;
+	double substepDays = 1.0;
+	size_t asteroidCount = 0;
+	size_t particleCount = 0;
+	size_t threadCount = std::thread::hardware_concurrency();
+	unsigned int seed = 42;
+	std::string checkpointPath;
+	std::string restorePath;
+	double monitorDays = 365.25;
+	std::string monitorCsvPath;
+	bool detectCollisions = false;
+	CollisionResponse collisionResponse = CollisionResponse::Merge;
+	size_t ensembleMembers = 0;
+	std::string ensembleCsvPath;
+	std::string catalogPath;
+	std::string compileCatalogPath;
+	std::vector<std::string> horizonsPaths;
+	std::string compileEphemerisPath;
+	double segmentDays = 8.0;
+	size_t coefficientCount = 12;
+	std::string ephemerisPath;
+	double epoch = J2000_JULIAN_DATE;
+
+	BodySystem bodies;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.rfind("--years=", 0) == 0) {
+			years = std::stod(arg.substr(8));
+		}
+		else if (arg.rfind("--integrator=", 0) == 0) {
+			if (!parseIntegratorType(arg.substr(13), integratorType)) {
+				std::cerr << "Unknown integrator " << arg.substr(13) << std::endl;
+				return 1;
+			}
+		}
+		else if (arg.rfind("--substep=", 0) == 0) {
+			substepDays = std::stod(arg.substr(10));
+		}
+		else if (arg.rfind("--asteroids=", 0) == 0) {
+			asteroidCount = std::stoul(arg.substr(12));
+		}
+		else if (arg.rfind("--particles=", 0) == 0) {
+			particleCount = std::stoul(arg.substr(12));
+		}
+		else if (arg.rfind("--threads=", 0) == 0) {
+			threadCount = std::stoul(arg.substr(10));
+		}
+		else if (arg.rfind("--seed=", 0) == 0) {
+			seed = static_cast<unsigned int>(std::stoul(arg.substr(7)));
+		}
+		else if (arg.rfind("--checkpoint=", 0) == 0) {
+			checkpointPath = arg.substr(13);
+		}
+		else if (arg.rfind("--restore=", 0) == 0) {
+			restorePath = arg.substr(10);
+		}
+		else if (arg.rfind("--monitor-days=", 0) == 0) {
+			monitorDays = std::stod(arg.substr(15));
+		}
+		else if (arg.rfind("--monitor-csv=", 0) == 0) {
+			monitorCsvPath = arg.substr(14);
+		}
+		else if (arg.rfind("--collisions=", 0) == 0) {
+			if (!parseCollisionResponse(arg.substr(13), collisionResponse)) {
+				std::cerr << "Unknown collision response " << arg.substr(13) << std::endl;
+				return 1;
+			}
+			detectCollisions = true;
+		}
+		else if (arg.rfind("--ensemble=", 0) == 0) {
+			ensembleMembers = std::stoul(arg.substr(11));
+		}
+		else if (arg.rfind("--ensemble-csv=", 0) == 0) {
+			ensembleCsvPath = arg.substr(15);
+		}
+		else if (arg.rfind("--catalog=", 0) == 0) {
+			catalogPath = arg.substr(10);
+		}
+		else if (arg.rfind("--compile-catalog=", 0) == 0) {
+			compileCatalogPath = arg.substr(18);
+		}
+		else if (arg.rfind("--import-horizons=", 0) == 0) {
+			std::stringstream list(arg.substr(18));
+			std::string path;
+			while (std::getline(list, path, ',')) horizonsPaths.push_back(path);
+		}
+		else if (arg.rfind("--compile-ephemeris=", 0) == 0) {
+			compileEphemerisPath = arg.substr(20);
+		}
+		else if (arg.rfind("--segment-days=", 0) == 0) {
+			segmentDays = std::stod(arg.substr(15));
+		}
+		else if (arg.rfind("--coefficients=", 0) == 0) {
+			coefficientCount = std::stoul(arg.substr(15));
+		}
+		else if (arg.rfind("--ephemeris=", 0) == 0) {
+			ephemerisPath = arg.substr(12);
+		}
+		else if (arg.rfind("--epoch=", 0) == 0) {
+			epoch = std::stod(arg.substr(8));
+		}
+		else if (arg == "--barnes-hut") {
+			bodies.forceSolver = ForceSolver::BarnesHut;
+		}
+		else if (arg.rfind("--theta=", 0) == 0) {
+			bodies.openingAngle = std::stod(arg.substr(8));
+		}
+		else if (arg.rfind("--kernel=", 0) == 0) {
+			if (!parseGravityKernel(arg.substr(9), bodies.gravityKernel)) {
+				std::cerr << "Unknown kernel " << arg.substr(9) << std::endl;
+				return 1;
+			}
+			if (!gravityKernelSupported(bodies.gravityKernel)) {
+				std::cerr << "This CPU cannot run the " << arg.substr(9) << " kernel, the best it supports is "
+					<< gravityKernelName(detectGravityKernel()) << std::endl;
+				return 1;
+			}
+		}
+		else if (arg.rfind("--force=", 0) == 0) {
+			if (!parseForceModel(arg.substr(8), bodies.forceModel)) {
+				std::cerr << "Unknown force model " << arg.substr(8) << std::endl;
+				return 1;
+			}
+		}
+		else if (arg.rfind("--softening=", 0) == 0) {
+			bodies.softening = std::stod(arg.substr(12));
+		}
+		else if (arg == "--precision=mixed" || arg == "--precision=double") {
+			bodies.forcePrecision = arg == "--precision=mixed" ? ForcePrecision::Mixed : ForcePrecision::Double;
+			bodies.particles.precision = bodies.forcePrecision;
+		}
+		else {
+			std::cerr << "Usage: headless [--years=N] [--integrator=NAME] [--substep=DAYS]"
+				" [--asteroids=N] [--particles=N] [--threads=N] [--seed=N]"
+				" [--checkpoint=PATH] [--restore=PATH] [--monitor-days=N] [--monitor-csv=PATH]"
+				" [--collisions=log|merge|bounce] [--ensemble=N] [--ensemble-csv=PATH]"
+				" [--barnes-hut] [--theta=X] [--kernel=scalar|avx2|avx512] [--precision=double|mixed]"
+				" [--force=newtonian|plummer|1pn] [--softening=M]"
+				" [--catalog=PATH] [--compile-catalog=PATH]"
+				" [--import-horizons=FILE,... --compile-ephemeris=PATH] [--segment-days=N] [--coefficients=N]"
+				" [--ephemeris=PATH] [--epoch=JD]" << std::endl;
+			return 1;
+		}
+	}
+
+	// Importing is a run of its own: Horizons vector tables fitted into a Chebyshev table
+	if (!horizonsPaths.empty()) {
+		if (compileEphemerisPath.empty()) {
+			std::cerr << "--import-horizons needs --compile-ephemeris=PATH" << std::endl;
+			return 1;
+		}
+		std::vector<ChebyshevFit> fits;
+		std::string error;
+		if (!importHorizons(horizonsPaths, compileEphemerisPath, Days(segmentDays), coefficientCount, fits, error)) {
+			std::cerr << "Cannot import, " << error << std::endl;
+			return 1;
+		}
+		for (const ChebyshevFit& fit : fits) {
+			std::cout << std::setw(12) << fit.name << std::setw(8) << fit.segmentCount << " segments of "
+				<< std::fixed << std::setprecision(3) << Days(Seconds(fit.segmentSeconds)).value() << " days, max error "
+				<< std::scientific << std::setprecision(3) << fit.maxError << " m" << std::defaultfloat << std::endl;
+		}
+		std::cout << "compiled " << fits.size() << " bodies to " << compileEphemerisPath << std::endl;
+		return 0;
+	}
+
+	// Bodies from a catalog file, CSV, JSON or compiled, instead of the built-in solar system
+	BodyCatalog catalog;
+	if (!catalogPath.empty()) {
+		auto start = std::chrono::steady_clock::now();
+		if (!catalog.open(catalogPath)) {
+			std::cerr << "Cannot load catalog, " << catalog.error << std::endl;
+			return 1;
+		}
+		std::cout << (catalog.isCompiled() ? "mapped " : "parsed ") << catalogPath << ", " << catalog.size() << " bodies in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	}
+	else {
+		catalog.useBuiltIn();
+	}
+
+	// Compiling is a run of its own
+	if (!compileCatalogPath.empty()) {
+		if (!catalog.compile(compileCatalogPath)) {
+			std::cerr << "Cannot write catalog " << compileCatalogPath << std::endl;
+			return 1;
+		}
+		std::cout << "compiled " << catalog.size() << " bodies to " << compileCatalogPath << std::endl;
+		return 0;
+	}
+
+	// An ensemble is a run of its own, seeded per member
+	if (ensembleMembers > 0) {
+		ThreadPool pool(threadCount);
+		return runEnsemble(ensembleMembers, seed, catalog, asteroidCount, years, substepDays, pool, ensembleCsvPath);
+	}
+
+	// A restored run replaces the seeded system entirely
+	double simTime = 0.0;
+	if (!restorePath.empty()) {
+		CheckpointView checkpoint;
+		auto start = std::chrono::steady_clock::now();
+		if (!checkpoint.open(restorePath)) {
+			std::cerr << "Cannot read checkpoint " << restorePath << std::endl;
+			return 1;
+		}
+		checkpoint.restore(bodies);
+		simTime = checkpoint.simTime();
+		std::cout << "restored " << restorePath << " at year " << Years(Seconds(simTime)).value() << " in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	}
+	else {
+		srand(seed);
+		auto start = std::chrono::steady_clock::now();
+		catalog.addBodies(bodies);
+		if (!catalogPath.empty()) {
+			std::cout << "loaded " << bodies.size() << " bodies in "
+				<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+		}
+		addAsteroidBelt(bodies, asteroidCount);
+		addAsteroidBeltParticles(bodies, particleCount);
+
+		// Catalog bodies the ephemeris knows start from their state at the epoch
+		if (!ephemerisPath.empty()) {
+			ChebyshevTable ephemeris;
+			if (!ephemeris.open(ephemerisPath)) {
+				std::cerr << "Cannot read ephemeris " << ephemerisPath << std::endl;
+				return 1;
+			}
+			simTime = julianDateToSeconds(epoch);
+			size_t set = setEphemerisStates(ephemeris, bodies, simTime, [&](size_t i) {
+				return i < catalog.size() ? catalog.name(i) : std::string_view();
+			});
+			std::cout << "ephemeris " << ephemerisPath << " at JD " << std::fixed << std::setprecision(1) << epoch
+				<< std::defaultfloat << ", " << set << " bodies set" << std::endl;
+		}
+	}
+
+	ThreadPool pool(threadCount);
+	bodies.pool = &pool;
+
+	std::unique_ptr<Integrator> integrator = makeIntegrator(integratorType);
+	integrator->maxSubstep = Days(substepDays);
+
+	CollisionDetector collisions(collisionResponse);
+	collisions.time = simTime;
+	if (detectCollisions) integrator->collisions = &collisions;
+
+	ConservationMonitor monitor{ Days(monitorDays) };
+
+	std::cout << "integrator " << integrator->name()
+		<< ", substep " << substepDays << " days"
+		<< ", " << bodies.size() << " bodies"
+		<< ", " << bodies.particles.size() << " particles"
+		<< ", " << pool.threadCount() << " threads"
+		<< ", kernel " << gravityKernelName(bodies.gravityKernel)
+		<< ", " << forcePrecisionName(bodies.forcePrecision) << " precision"
+		<< ", force " << forceModelName(bodies.forceModel) << std::endl;
+	std::cout << std::setw(8) << "year"
+		<< std::setw(14) << "wall(s)"
+		<< std::setw(16) << "energy drift"
+		<< std::setw(16) << "momentum drift"
+		<< std::setw(16) << "angular drift" << std::endl;
+
+	// Advance one monitor interval per call. Only the time spent in advance()
+	// counts toward throughput, not the samples in between.
+	const double startTime = simTime;
+	const double endTime = simTime + Seconds(Years(years)).value();
+	unsigned long long steps = 0;
+	double seconds = 0.0;
+	monitor.sample(bodies, simTime);
+	while (simTime < endTime) {
+		Seconds span(std::min(monitor.interval.value(), endTime - simTime));
+		monitor.prepare(bodies, simTime + span.value());
+
+		auto start = std::chrono::steady_clock::now();
+		integrator->advance(bodies, span);
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		steps += static_cast<unsigned long long>(std::ceil(span / integrator->maxSubstep));
+		simTime += span.value();
+
+		if (monitor.sample(bodies, simTime)) {
+			const ConservationSample& s = monitor.latest();
+			std::cout << std::setw(8) << std::fixed << std::setprecision(2) << Years(Seconds(simTime - startTime)).value()
+				<< std::setw(14) << std::setprecision(3) << seconds
+				<< std::scientific << std::setprecision(3)
+				<< std::setw(16) << s.energyDrift
+				<< std::setw(16) << s.momentumDrift
+				<< std::setw(16) << s.angularDrift
+				<< std::defaultfloat << std::endl;
+		}
+
+		for (const CollisionEvent& event : collisions.events) {
+			if (event.type != EncounterType::Collision) continue;
+			std::cout << "  collision at day " << std::fixed << std::setprecision(1) << Days(Seconds(event.time)).value()
+				<< ": bodies " << event.a << " and " << event.b
+				<< ", " << std::scientific << std::setprecision(3) << event.relativeSpeed << " m/s"
+				<< (event.resolved ? "" : ", not resolved") << std::defaultfloat << std::endl;
+		}
+		collisions.events.clear();
+	}
+
+	double bodySteps = static_cast<double>(steps) * (bodies.size() + bodies.particles.size());
+	double drift = monitor.latest().energyDrift;
+
+	std::cout << "steps              " << steps << std::endl;
+	std::cout << "wall time          " << seconds << " s" << std::endl;
+	std::cout << "body-steps/s       " << std::scientific << std::setprecision(3) << bodySteps / seconds << std::defaultfloat << std::endl;
+	std::cout << "force evaluations  " << bodies.forceEvaluations << " (" << bodies.bodyEvaluations << " body evaluations)" << std::endl;
+	std::cout << "energy drift       " << std::scientific << std::setprecision(3) << drift
+		<< " (max " << monitor.maxEnergyDrift() << ")" << std::defaultfloat << std::endl;
+	if (detectCollisions) {
+		std::cout << "close encounters   " << collisions.encounterCount << std::endl;
+		std::cout << "collisions         " << collisions.collisionCount << std::endl;
+	}
+
+	if (!monitorCsvPath.empty()) {
+		std::ofstream csv(monitorCsvPath);
+		monitor.writeCSV(csv);
+	}
+
+	if (!checkpointPath.empty()) {
+		CheckpointData data;
+		captureCheckpoint(bodies, simTime, data);
+		if (!writeCheckpoint(checkpointPath, data)) {
+			std::cerr << "Cannot write checkpoint " << checkpointPath << std::endl;
+			return 1;
+		}
+		std::cout << "checkpoint         " << checkpointPath << std::endl;
+	}
+	return 0;
+}
@@ -2,8 +2,8 @@
 
 out vec4 FragColor;
 
-uniform vec3 color;
+uniform vec3 ourColor;
 
 void main() {
-    FragColor = vec4(color, 1.0);
+    FragColor = vec4(ourColor, 1.0);
 }
\ No newline at end of file
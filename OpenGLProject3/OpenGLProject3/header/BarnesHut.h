@@ -0,0 +1,266 @@
+#ifndef BARNESHUT_H
+#define BARNESHUT_H
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <ForceModel.h>
+
+// Barnes-Hut octree over structure-of-arrays positions.
+// Rebuilt from scratch on every build() call: the body indices are sorted into
+// octants in place, and each node stores its mass and center of mass, so a far
+// away node can stand in for all the bodies below it.
+class BarnesHutTree {
+private:
+	struct Node {
+		// Geometric cube
+		double cx, cy, cz;
+		double half;
+
+		// Total mass and center of mass
+		double mass;
+		double mx, my, mz;
+
+		// Children are stored contiguously, leaves own a range of sorted bodies
+		int firstChild;
+		int childCount;
+		size_t bodyStart;
+		size_t bodyCount;
+	};
+
+	std::vector<Node> nodes;
+
+	// Body indices sorted so every node covers a contiguous range
+	std::vector<size_t> order;
+	std::vector<size_t> scratch;
+
+	// Positions and masses copied into tree order, so leaves read contiguous memory
+	std::vector<double> sx, sy, sz, sm;
+
+	const double* px = nullptr;
+	const double* py = nullptr;
+	const double* pz = nullptr;
+	const double* pm = nullptr;
+
+	void buildNode(int nodeIndex, int depth) {
+		Node node = nodes[nodeIndex];
+
+		// Mass and center of mass of the bodies in range
+		double mass = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+		for (size_t k = node.bodyStart; k < node.bodyStart + node.bodyCount; k++) {
+			size_t b = order[k];
+			mass += pm[b];
+			mx += pm[b] * px[b];
+			my += pm[b] * py[b];
+			mz += pm[b] * pz[b];
+		}
+		node.mass = mass;
+		if (mass > 0.0) {
+			node.mx = mx / mass; node.my = my / mass; node.mz = mz / mass;
+		}
+		else {
+			node.mx = node.cx; node.my = node.cy; node.mz = node.cz;
+		}
+
+		// Small ranges and runaway depth (coincident bodies) stay leaves
+		if (node.bodyCount <= leafSize || depth >= MAX_DEPTH) {
+			nodes[nodeIndex] = node;
+			return;
+		}
+
+		// Counting sort of the range into the 8 octants
+		size_t counts[8] = { 0 };
+		for (size_t k = node.bodyStart; k < node.bodyStart + node.bodyCount; k++) {
+			counts[octantOf(node, order[k])]++;
+		}
+		size_t offsets[8];
+		size_t running = node.bodyStart;
+		for (int o = 0; o < 8; o++) {
+			offsets[o] = running;
+			running += counts[o];
+		}
+		size_t starts[8];
+		std::copy(offsets, offsets + 8, starts);
+		for (size_t k = node.bodyStart; k < node.bodyStart + node.bodyCount; k++) {
+			size_t b = order[k];
+			scratch[offsets[octantOf(node, b)]++] = b;
+		}
+		std::copy(scratch.begin() + node.bodyStart, scratch.begin() + node.bodyStart + node.bodyCount,
+			order.begin() + node.bodyStart);
+
+		// Allocate the non-empty children next to each other
+		node.firstChild = static_cast<int>(nodes.size());
+		node.childCount = 0;
+		double childHalf = node.half * 0.5;
+		for (int o = 0; o < 8; o++) {
+			if (counts[o] == 0) continue;
+			Node child;
+			child.cx = node.cx + ((o & 1) ? childHalf : -childHalf);
+			child.cy = node.cy + ((o & 2) ? childHalf : -childHalf);
+			child.cz = node.cz + ((o & 4) ? childHalf : -childHalf);
+			child.half = childHalf;
+			child.mass = 0.0;
+			child.mx = child.my = child.mz = 0.0;
+			child.firstChild = -1;
+			child.childCount = 0;
+			child.bodyStart = starts[o];
+			child.bodyCount = counts[o];
+			nodes.push_back(child);
+			node.childCount++;
+		}
+		nodes[nodeIndex] = node;
+
+		// nodes may reallocate while recursing, so only indices are kept
+		for (int c = 0; c < node.childCount; c++) {
+			buildNode(node.firstChild + c, depth + 1);
+		}
+	}
+
+	int octantOf(const Node& node, size_t b) const {
+		return (px[b] >= node.cx ? 1 : 0) | (py[b] >= node.cy ? 2 : 0) | (pz[b] >= node.cz ? 4 : 0);
+	}
+
+public:
+	static const int MAX_DEPTH = 48;
+
+	// Traversal stack bound: every level pops one node and pushes at most 8
+	static const int MAX_STACK = 7 * (MAX_DEPTH + 1) + 1;
+
+	// Bodies per leaf, summed directly
+	size_t leafSize = 8;
+
+	size_t nodeCount() const {
+		return nodes.size();
+	}
+
+	void build(const double* x, const double* y, const double* z, const double* m, size_t n) {
+		px = x; py = y; pz = z; pm = m;
+		nodes.clear();
+		if (n == 0) return;
+
+		order.resize(n);
+		scratch.resize(n);
+		for (size_t i = 0; i < n; i++) order[i] = i;
+
+		// Bounding cube of all bodies
+		double minX = x[0], maxX = x[0], minY = y[0], maxY = y[0], minZ = z[0], maxZ = z[0];
+		for (size_t i = 1; i < n; i++) {
+			minX = std::min(minX, x[i]); maxX = std::max(maxX, x[i]);
+			minY = std::min(minY, y[i]); maxY = std::max(maxY, y[i]);
+			minZ = std::min(minZ, z[i]); maxZ = std::max(maxZ, z[i]);
+		}
+
+		Node root;
+		root.cx = 0.5 * (minX + maxX);
+		root.cy = 0.5 * (minY + maxY);
+		root.cz = 0.5 * (minZ + maxZ);
+		root.half = 0.5 * std::max(maxX - minX, std::max(maxY - minY, maxZ - minZ)) * 1.0001 + 1.0;
+		root.mass = 0.0;
+		root.mx = root.my = root.mz = 0.0;
+		root.firstChild = -1;
+		root.childCount = 0;
+		root.bodyStart = 0;
+		root.bodyCount = n;
+
+		nodes.reserve(n / 2 + 1);
+		nodes.push_back(root);
+		buildNode(0, 0);
+
+		sx.resize(n); sy.resize(n); sz.resize(n); sm.resize(n);
+		for (size_t k = 0; k < n; k++) {
+			size_t b = order[k];
+			sx[k] = x[b]; sy[k] = y[b]; sz[k] = z[b]; sm[k] = m[b];
+		}
+	}
+
+	size_t bodyCount() const {
+		return order.size();
+	}
+
+	// Accelerations of every body from the tree built last, written by original index.
+	// Targets are visited in tree order so consecutive walks touch the same nodes.
+	void computeAccelerations(double G, double theta, double* ax, double* ay, double* az) const {
+		computeAccelerations(G, theta, ax, ay, az, 0, order.size());
+	}
+
+	// Same for the tree positions [begin, end) only. The walk keeps no state in
+	// the tree, so disjoint ranges can run on different threads. The potential
+	// is stored too when pot is not null.
+	void computeAccelerations(double G, double theta, double* ax, double* ay, double* az,
+		size_t begin, size_t end, double* pot = nullptr) const {
+		for (size_t k = begin; k < end; k++) {
+			size_t i = order[k];
+			accelerationOnSorted(k, G, theta, ax[i], ay[i], az[i], pot ? &pot[i] : nullptr);
+		}
+	}
+
+	// Acceleration on the body at tree position k. theta is the opening angle:
+	// a node of size s at distance d is used as a point mass when s/d < theta.
+	void accelerationOnSorted(size_t k, double G, double theta, double& outAx, double& outAy, double& outAz,
+		double* outPot = nullptr) const {
+		const double xi = sx[k], yi = sy[k], zi = sz[k];
+		const double thetaSq = theta * theta;
+
+		double sumX = 0.0, sumY = 0.0, sumZ = 0.0, sumPot = 0.0;
+
+		int stack[MAX_STACK];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node& node = nodes[stack[--top]];
+
+			if (node.firstChild < 0) {
+				// Leaf, direct sum over its bodies
+				const size_t end = node.bodyStart + node.bodyCount;
+				for (size_t j = node.bodyStart; j < end; j++) {
+					if (j == k) continue;
+
+					double dx = sx[j] - xi;
+					double dy = sy[j] - yi;
+					double dz = sz[j] - zi;
+					double distSq = dx * dx + dy * dy + dz * dz;
+
+					// Skip overlapping bodies, same cutoff as the direct sum (1e6 m)
+					if (distSq < GRAVITY_CUTOFF_SQ) continue;
+
+					double invDist = 1.0 / std::sqrt(distSq);
+					double s = G * sm[j] * invDist * invDist * invDist;
+					sumX += dx * s;
+					sumY += dy * s;
+					sumZ += dz * s;
+					if (outPot) sumPot -= G * sm[j] * invDist;
+				}
+				continue;
+			}
+
+			double dx = node.mx - xi;
+			double dy = node.my - yi;
+			double dz = node.mz - zi;
+			double distSq = dx * dx + dy * dy + dz * dz;
+			double size = 2.0 * node.half;
+
+			if (size * size < thetaSq * distSq) {
+				// Far enough away, use the node's center of mass
+				double invDist = 1.0 / std::sqrt(distSq);
+				double s = G * node.mass * invDist * invDist * invDist;
+				sumX += dx * s;
+				sumY += dy * s;
+				sumZ += dz * s;
+				if (outPot) sumPot -= G * node.mass * invDist;
+			}
+			else {
+				for (int c = 0; c < node.childCount; c++) {
+					stack[top++] = node.firstChild + c;
+				}
+			}
+		}
+
+		outAx = sumX;
+		outAy = sumY;
+		outAz = sumZ;
+		if (outPot) *outPot = sumPot;
+	}
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef BLOCKTIMESTEP_H
+#define BLOCKTIMESTEP_H
+
+#include <Integrator.h>
+#include <BodySystem.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Hierarchical block timesteps. Every body steps with dt / 2^level, where the
+// level comes from the Aarseth-style criterion eta * |a| / |jerk|. Within one
+// block step only the bodies whose own step ends are re-evaluated and kicked,
+// so slow outer bodies cost a fraction of the force evaluations of fast ones.
+// Each body follows kick-drift-kick, all positions are drifted together.
+// Test particles take one kick-drift-kick over the whole block.
+class BlockTimestepIntegrator : public Integrator {
+private:
+	// Per body step level, step is dt >> level
+	std::vector<int> level;
+
+	// Jerk from the last evaluation
+	std::vector<double> jx, jy, jz;
+
+	std::vector<size_t> active;
+
+	// Smallest allowed level for a body that should take a step of size desired
+	int levelFor(double dt, double desired) const {
+		if (desired >= dt) return 0;
+		int l = static_cast<int>(std::ceil(std::log2(dt / desired)));
+		return std::min(l, maxLevel);
+	}
+
+	double desiredStep(size_t i, const BodySystem& bodies) const {
+		double a = std::sqrt(bodies.ax[i] * bodies.ax[i] + bodies.ay[i] * bodies.ay[i] + bodies.az[i] * bodies.az[i]);
+		double j = std::sqrt(jx[i] * jx[i] + jy[i] * jy[i] + jz[i] * jz[i]);
+		if (j <= 0.0) return 1e300;
+		return eta * a / j;
+	}
+
+	// Evaluate every body, used on the first step or after bodies were added
+	void initialize(BodySystem& bodies) {
+		const size_t n = bodies.size();
+		level.assign(n, 0);
+		jx.assign(n, 0.0); jy.assign(n, 0.0); jz.assign(n, 0.0);
+
+		active.resize(n);
+		for (size_t i = 0; i < n; i++) active[i] = i;
+		bodies.computeAccelerationsAndJerk(active, jx, jy, jz);
+		bodies.computeParticleAccelerations();
+		bodies.accelerationsValid = true;
+	}
+
+	void halfKick(BodySystem& bodies, size_t i, double dt) {
+		double h = 0.5 * (dt / static_cast<double>(1LL << level[i]));
+		bodies.vx[i] += bodies.ax[i] * h;
+		bodies.vy[i] += bodies.ay[i] * h;
+		bodies.vz[i] += bodies.az[i] * h;
+	}
+
+public:
+	// Accuracy parameter of the timestep criterion
+	double eta = 0.05;
+
+	// Deepest level, smallest step is dt / 2^maxLevel
+	int maxLevel = 12;
+
+	BlockTimestepIntegrator() {
+		// One block spans many inner steps, so allow long blocks by default
+		maxSubstep = Days(64.0);
+	}
+
+	const char* name() const override { return "block"; }
+
+	// Depends on the levels, one evaluation per body step
+	int evaluationsPerStep() const override { return 1; }
+
+	void step(BodySystem& bodies, double dt) override {
+		const size_t n = bodies.size();
+		if (level.size() != n || !bodies.accelerationsValid) {
+			initialize(bodies);
+		}
+
+		// Positions are advanced on a grid of 2^maxLevel ticks
+		const long long ticks = 1LL << maxLevel;
+		const double tickDt = dt / static_cast<double>(ticks);
+
+		// Every body starts a step at the beginning of the block, where
+		// any level is aligned, so all levels can be chosen freely here
+		for (size_t i = 0; i < n; i++) {
+			level[i] = levelFor(dt, desiredStep(i, bodies));
+			halfKick(bodies, i, dt);
+		}
+		bodies.particles.kick(0.5 * dt, bodies.pool);
+
+		long long t = 0;
+		while (t < ticks) {
+			// Jump straight to the next tick where some body ends its step
+			int deepest = *std::max_element(level.begin(), level.end());
+			long long stride = ticks >> deepest;
+			long long next = (t / stride + 1) * stride;
+
+			bodies.drift(static_cast<double>(next - t) * tickDt);
+			t = next;
+
+			active.clear();
+			for (size_t i = 0; i < n; i++) {
+				long long own = ticks >> level[i];
+				if (t % own == 0) active.push_back(i);
+			}
+
+			bodies.computeAccelerationsAndJerk(active, jx, jy, jz);
+
+			for (size_t i : active) {
+				// Close the finished step with its own size
+				halfKick(bodies, i, dt);
+
+				// Pick the next level. Smaller steps are always allowed, a larger
+				// step only when this tick is aligned to it so blocks stay nested.
+				int wanted = levelFor(dt, desiredStep(i, bodies));
+				while (wanted < level[i] && t % (ticks >> wanted) != 0) wanted++;
+				level[i] = wanted;
+
+				if (t < ticks) {
+					halfKick(bodies, i, dt);
+				}
+			}
+		}
+
+		bodies.computeParticleAccelerations();
+		bodies.particles.kick(0.5 * dt, bodies.pool);
+
+		// All bodies end together, so the stored accelerations match the positions
+		bodies.accelerationsValid = true;
+	}
+
+	int getLevel(size_t i) const {
+		return level[i];
+	}
+};
+
+#endif
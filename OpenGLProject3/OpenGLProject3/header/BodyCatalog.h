@@ -0,0 +1,588 @@
+#ifndef BODYCATALOG_H
+#define BODYCATALOG_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cctype>
+#include <PlanetData.h>
+#include <SolarSystem.h>
+#include <BodySystem.h>
+#include <MappedFile.h>
+
+// Body catalogs. Authored as CSV or JSON, one entry per body with the fields of
+// PlanetData, and compiled into a binary file that is mapped instead of parsed:
+//
+// CSV, a header row naming the columns, '#' starts a comment line:
+//   name,mass,radius,distance,period,inclination,r,g,b
+//   Sun,1.989e30,6.96e8,0,0,0,1,1,0
+// Only name and mass are required. Columns x,y,z,vx,vy,vz give an explicit
+// heliocentric state in m and m/s instead of the circular orbit.
+//
+// JSON, an array of objects with the same keys, colour and state as arrays:
+//   [{"name": "Sun", "mass": 1.989e30, "color": [1, 1, 0]},
+//    {"name": "Ceres", "mass": 9.38e20, "position": [...], "velocity": [...]}]
+//
+// Binary, all little-endian:
+//   BodyCatalogHeader
+//   records:     recordCount BodyCatalogRecord, in catalog order
+//   name index:  recordCount uint32 record numbers, sorted by name
+//   strings:     every name once, not terminated, found by offset and length
+// Every section starts on a 64 byte boundary. Opening checks the header only,
+// so it costs the same for any catalog size, and loading touches each page once.
+const char BODY_CATALOG_MAGIC[8] = { 'N', 'B', 'O', 'D', 'Y', 'C', 'A', 'T' };
+const uint32_t BODY_CATALOG_VERSION = 1;
+const uint32_t BODY_CATALOG_BYTE_ORDER = 0x01020304;
+const size_t BODY_CATALOG_ALIGN = 64;
+
+// Record flags
+const uint32_t BODY_CATALOG_HAS_STATE = 1;
+
+struct BodyCatalogHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t fileSize;
+	uint64_t recordCount;
+	uint64_t recordOffset;
+	uint64_t indexOffset;
+	uint64_t stringOffset;
+	uint64_t stringBytes;
+	uint64_t reserved[8];
+};
+
+struct BodyCatalogRecord {
+	double mass;            // kg
+	double radius;          // m
+	double distanceFromSun; // m
+	double orbitalPeriod;   // years
+	double inclination;     // degrees
+	double position[3];     // m, with BODY_CATALOG_HAS_STATE
+	double velocity[3];     // m/s, with BODY_CATALOG_HAS_STATE
+	float color[3];
+	uint32_t flags;
+	uint32_t nameOffset;    // into the string table
+	uint32_t nameLength;
+};
+
+static_assert(sizeof(BodyCatalogHeader) == 128, "body catalog header layout changed");
+static_assert(sizeof(BodyCatalogRecord) == 112, "body catalog record layout changed");
+
+inline uint64_t alignBodyCatalogOffset(uint64_t offset) {
+	return (offset + BODY_CATALOG_ALIGN - 1) / BODY_CATALOG_ALIGN * BODY_CATALOG_ALIGN;
+}
+
+// Write entries as a binary catalog, through path + ".tmp" and a rename like checkpoints
+inline bool writeBodyCatalog(const std::string& path, const std::vector<PlanetData>& entries) {
+	const uint64_t count = entries.size();
+
+	std::vector<BodyCatalogRecord> records(entries.size());
+	std::string strings;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const PlanetData& entry = entries[i];
+		BodyCatalogRecord& record = records[i];
+		std::memset(&record, 0, sizeof(record));
+		record.mass = entry.mass;
+		record.radius = entry.radius;
+		record.distanceFromSun = entry.distanceFromSun;
+		record.orbitalPeriod = entry.orbitalPeriod;
+		record.inclination = entry.inclination;
+		for (int k = 0; k < 3; k++) {
+			record.position[k] = entry.position[k];
+			record.velocity[k] = entry.velocity[k];
+			record.color[k] = entry.color[k];
+		}
+		record.flags = entry.hasState ? BODY_CATALOG_HAS_STATE : 0;
+		record.nameOffset = static_cast<uint32_t>(strings.size());
+		record.nameLength = static_cast<uint32_t>(entry.name.size());
+		strings += entry.name;
+	}
+	if (strings.size() > UINT32_MAX) return false;
+
+	std::vector<uint32_t> index(entries.size());
+	for (size_t i = 0; i < index.size(); i++) index[i] = static_cast<uint32_t>(i);
+	std::stable_sort(index.begin(), index.end(), [&](uint32_t a, uint32_t b) {
+		return entries[a].name < entries[b].name;
+	});
+
+	BodyCatalogHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, BODY_CATALOG_MAGIC, sizeof(header.magic));
+	header.version = BODY_CATALOG_VERSION;
+	header.byteOrder = BODY_CATALOG_BYTE_ORDER;
+	header.recordCount = count;
+	header.recordOffset = alignBodyCatalogOffset(sizeof(BodyCatalogHeader));
+	header.indexOffset = alignBodyCatalogOffset(header.recordOffset + count * sizeof(BodyCatalogRecord));
+	header.stringOffset = alignBodyCatalogOffset(header.indexOffset + count * sizeof(uint32_t));
+	header.stringBytes = strings.size();
+	header.fileSize = header.stringOffset + header.stringBytes;
+
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		uint64_t written = 0;
+		auto put = [&](const void* bytes, uint64_t length) {
+			out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(length));
+			written += length;
+		};
+		auto padTo = [&](uint64_t offset) {
+			static const char zeros[BODY_CATALOG_ALIGN] = { 0 };
+			if (offset > written) put(zeros, offset - written);
+		};
+
+		put(&header, sizeof(header));
+		padTo(header.recordOffset);
+		put(records.data(), records.size() * sizeof(BodyCatalogRecord));
+		padTo(header.indexOffset);
+		put(index.data(), index.size() * sizeof(uint32_t));
+		padTo(header.stringOffset);
+		put(strings.data(), strings.size());
+
+		if (!out) return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	return !error;
+}
+
+// A binary catalog mapped into memory. Records and names are read in place;
+// nothing is copied until a body is added or an entry is asked for.
+class BodyCatalogView {
+private:
+	MappedFile file;
+	const BodyCatalogHeader* header = nullptr;
+
+	const uint32_t* nameIndex() const {
+		return reinterpret_cast<const uint32_t*>(file.data() + header->indexOffset);
+	}
+
+	// Name of the record an index entry points to. The entries are not checked
+	// on open, one past the records reads as an empty name.
+	std::string_view indexedName(uint32_t i) const {
+		return i < header->recordCount ? name(i) : std::string_view();
+	}
+
+public:
+	static const size_t npos = static_cast<size_t>(-1);
+
+	// Maps the file and checks that every section lies inside it
+	bool open(const std::string& path) {
+		header = nullptr;
+		if (!file.open(path) || file.size() < sizeof(BodyCatalogHeader)) return false;
+
+		const BodyCatalogHeader* candidate = reinterpret_cast<const BodyCatalogHeader*>(file.data());
+		if (std::memcmp(candidate->magic, BODY_CATALOG_MAGIC, sizeof(BODY_CATALOG_MAGIC)) != 0) return false;
+		if (candidate->version != BODY_CATALOG_VERSION) return false;
+		if (candidate->byteOrder != BODY_CATALOG_BYTE_ORDER) return false;
+		if (candidate->fileSize != file.size()) return false;
+		if (candidate->recordCount > file.size() / sizeof(BodyCatalogRecord)) return false;
+		if (candidate->recordOffset > file.size() || candidate->indexOffset > file.size()) return false;
+		if (candidate->stringOffset > file.size() || candidate->stringBytes > file.size()) return false;
+
+		const uint64_t recordEnd = candidate->recordOffset + candidate->recordCount * sizeof(BodyCatalogRecord);
+		const uint64_t indexEnd = candidate->indexOffset + candidate->recordCount * sizeof(uint32_t);
+		if (candidate->recordOffset % BODY_CATALOG_ALIGN != 0 || recordEnd > candidate->indexOffset) return false;
+		if (candidate->indexOffset % BODY_CATALOG_ALIGN != 0 || indexEnd > candidate->stringOffset) return false;
+		if (candidate->stringOffset + candidate->stringBytes > file.size()) return false;
+
+		header = candidate;
+		return true;
+	}
+
+	void close() {
+		file.close();
+		header = nullptr;
+	}
+
+	bool isOpen() const {
+		return header != nullptr;
+	}
+
+	size_t size() const {
+		return header ? static_cast<size_t>(header->recordCount) : 0;
+	}
+
+	const BodyCatalogRecord& record(size_t i) const {
+		return reinterpret_cast<const BodyCatalogRecord*>(file.data() + header->recordOffset)[i];
+	}
+
+	// Name of record i, pointing into the mapping. Empty if it lies outside the string table.
+	std::string_view name(size_t i) const {
+		const BodyCatalogRecord& r = record(i);
+		if (uint64_t(r.nameOffset) + r.nameLength > header->stringBytes) return std::string_view();
+		return std::string_view(reinterpret_cast<const char*>(file.data() + header->stringOffset) + r.nameOffset, r.nameLength);
+	}
+
+	// Record with this name, binary search over the name index, npos if there is none
+	size_t find(std::string_view wanted) const {
+		if (!header) return npos;
+		const uint32_t* index = nameIndex();
+		const uint32_t* end = index + header->recordCount;
+		const uint32_t* found = std::lower_bound(index, end, wanted, [&](uint32_t i, std::string_view value) {
+			return indexedName(i) < value;
+		});
+		if (found == end || *found >= header->recordCount || name(*found) != wanted) return npos;
+		return *found;
+	}
+
+	// Record i as a catalog entry
+	PlanetData entry(size_t i) const {
+		const BodyCatalogRecord& r = record(i);
+		PlanetData data;
+		data.name = std::string(name(i));
+		data.mass = r.mass;
+		data.radius = r.radius;
+		data.distanceFromSun = r.distanceFromSun;
+		data.orbitalPeriod = r.orbitalPeriod;
+		data.inclination = r.inclination;
+		data.color = glm::vec3(r.color[0], r.color[1], r.color[2]);
+		data.hasState = (r.flags & BODY_CATALOG_HAS_STATE) != 0;
+		data.position = glm::dvec3(r.position[0], r.position[1], r.position[2]);
+		data.velocity = glm::dvec3(r.velocity[0], r.velocity[1], r.velocity[2]);
+		return data;
+	}
+
+	// Add record i to the system straight from the mapping, the name is not needed
+	size_t addBody(BodySystem& bodies, size_t i) const {
+		const BodyCatalogRecord& r = record(i);
+		if (r.flags & BODY_CATALOG_HAS_STATE) {
+			return bodies.addBody(r.mass, r.position[0], r.position[1], r.position[2],
+				r.velocity[0], r.velocity[1], r.velocity[2], r.radius);
+		}
+		return addCircularOrbitBody(bodies, r.mass, r.radius, r.distanceFromSun, r.inclination);
+	}
+};
+
+// Field of an authored entry by its CSV column or JSON key, false for an unknown name
+inline bool setCatalogField(PlanetData& entry, const std::string& field, double value) {
+	if (field == "mass") entry.mass = value;
+	else if (field == "radius") entry.radius = value;
+	else if (field == "distance") entry.distanceFromSun = value;
+	else if (field == "period") entry.orbitalPeriod = value;
+	else if (field == "inclination") entry.inclination = value;
+	else if (field == "r") entry.color.r = static_cast<float>(value);
+	else if (field == "g") entry.color.g = static_cast<float>(value);
+	else if (field == "b") entry.color.b = static_cast<float>(value);
+	else if (field == "x") entry.position.x = value;
+	else if (field == "y") entry.position.y = value;
+	else if (field == "z") entry.position.z = value;
+	else if (field == "vx") entry.velocity.x = value;
+	else if (field == "vy") entry.velocity.y = value;
+	else if (field == "vz") entry.velocity.z = value;
+	else return false;
+
+	if (field[0] == 'x' || field[0] == 'y' || field[0] == 'z' || field[0] == 'v') entry.hasState = true;
+	return true;
+}
+
+// An authored entry before any field is read: white, at the origin
+inline PlanetData emptyCatalogEntry() {
+	return PlanetData{ "", 0.0, 0.0, 0.0, 0.0, glm::vec3(1.0f), 0.0 };
+}
+
+inline std::string trimCatalogField(const std::string& text) {
+	size_t begin = text.find_first_not_of(" \t\r");
+	if (begin == std::string::npos) return std::string();
+	size_t end = text.find_last_not_of(" \t\r");
+	std::string field = text.substr(begin, end - begin + 1);
+	if (field.size() >= 2 && field.front() == '"' && field.back() == '"') field = field.substr(1, field.size() - 2);
+	return field;
+}
+
+inline bool parseCatalogNumber(const std::string& text, double& value) {
+	const char* begin = text.c_str();
+	char* end = nullptr;
+	value = std::strtod(begin, &end);
+	return end != begin && *end == '\0';
+}
+
+// Read a CSV catalog. Fields are split on commas, so names cannot contain one.
+inline bool readBodyCatalogCSV(std::istream& in, std::vector<PlanetData>& entries, std::string& error) {
+	std::vector<std::string> columns;
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(in, line)) {
+		lineNumber++;
+		std::string trimmed = trimCatalogField(line);
+		if (trimmed.empty() || trimmed[0] == '#') continue;
+
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, ',')) fields.push_back(trimCatalogField(field));
+
+		if (columns.empty()) {
+			columns = fields;
+			if (std::find(columns.begin(), columns.end(), "name") == columns.end() ||
+				std::find(columns.begin(), columns.end(), "mass") == columns.end()) {
+				error = "line " + std::to_string(lineNumber) + ": header needs name and mass columns";
+				return false;
+			}
+			continue;
+		}
+
+		if (fields.size() != columns.size()) {
+			error = "line " + std::to_string(lineNumber) + ": expected " + std::to_string(columns.size()) + " fields";
+			return false;
+		}
+
+		PlanetData entry = emptyCatalogEntry();
+		for (size_t c = 0; c < columns.size(); c++) {
+			if (columns[c] == "name") {
+				entry.name = fields[c];
+				continue;
+			}
+			double value;
+			if (!parseCatalogNumber(fields[c], value)) {
+				error = "line " + std::to_string(lineNumber) + ": " + columns[c] + " is not a number";
+				return false;
+			}
+			if (!setCatalogField(entry, columns[c], value)) {
+				error = "line " + std::to_string(lineNumber) + ": unknown column " + columns[c];
+				return false;
+			}
+		}
+		entries.push_back(std::move(entry));
+	}
+	return true;
+}
+
+// Just enough JSON for catalogs: an array of objects whose values are strings,
+// numbers or arrays of numbers
+class BodyCatalogJSONReader {
+private:
+	const std::string& text;
+	size_t at = 0;
+
+	void skipSpace() {
+		while (at < text.size() && std::isspace(static_cast<unsigned char>(text[at]))) at++;
+	}
+
+	bool expect(char c) {
+		skipSpace();
+		if (at >= text.size() || text[at] != c) return fail(std::string("expected '") + c + "'");
+		at++;
+		return true;
+	}
+
+	bool next(char c) {
+		skipSpace();
+		if (at < text.size() && text[at] == c) {
+			at++;
+			return true;
+		}
+		return false;
+	}
+
+	bool fail(const std::string& message) {
+		if (error.empty()) error = "offset " + std::to_string(at) + ": " + message;
+		return false;
+	}
+
+	bool readString(std::string& out) {
+		if (!expect('"')) return false;
+		out.clear();
+		while (at < text.size() && text[at] != '"') {
+			char c = text[at++];
+			if (c == '\\' && at < text.size()) {
+				char escaped = text[at++];
+				if (escaped == 'n') c = '\n';
+				else if (escaped == 't') c = '\t';
+				else c = escaped;
+			}
+			out += c;
+		}
+		return expect('"');
+	}
+
+	bool readNumber(double& value) {
+		skipSpace();
+		const char* begin = text.c_str() + at;
+		char* end = nullptr;
+		value = std::strtod(begin, &end);
+		if (end == begin) return fail("expected a number");
+		at += static_cast<size_t>(end - begin);
+		return true;
+	}
+
+	bool readNumbers(std::vector<double>& values) {
+		values.clear();
+		if (!expect('[')) return false;
+		if (next(']')) return true;
+		do {
+			double value;
+			if (!readNumber(value)) return false;
+			values.push_back(value);
+		} while (next(','));
+		return expect(']');
+	}
+
+	bool readEntry(PlanetData& entry) {
+		if (!expect('{')) return false;
+		if (next('}')) return true;
+		do {
+			std::string key;
+			if (!readString(key) || !expect(':')) return false;
+			skipSpace();
+
+			if (key == "name") {
+				if (!readString(entry.name)) return false;
+			}
+			else if (key == "color" || key == "position" || key == "velocity") {
+				std::vector<double> values;
+				if (!readNumbers(values)) return false;
+				if (values.size() != 3) return fail(key + " needs 3 values");
+				static const char* colorFields[3] = { "r", "g", "b" };
+				static const char* positionFields[3] = { "x", "y", "z" };
+				static const char* velocityFields[3] = { "vx", "vy", "vz" };
+				const char** fields = key == "color" ? colorFields : key == "position" ? positionFields : velocityFields;
+				for (int k = 0; k < 3; k++) setCatalogField(entry, fields[k], values[k]);
+			}
+			else {
+				double value;
+				if (!readNumber(value)) return false;
+				if (!setCatalogField(entry, key, value)) return fail("unknown key " + key);
+			}
+		} while (next(','));
+		return expect('}');
+	}
+
+public:
+	std::string error;
+
+	explicit BodyCatalogJSONReader(const std::string& text) : text(text) {}
+
+	bool read(std::vector<PlanetData>& entries) {
+		if (!expect('[')) return false;
+		if (next(']')) return true;
+		do {
+			PlanetData entry = emptyCatalogEntry();
+			if (!readEntry(entry)) return false;
+			entries.push_back(std::move(entry));
+		} while (next(','));
+		return expect(']');
+	}
+};
+
+// A catalog from any of the three formats. A compiled catalog stays mapped and
+// is read in place; an authored one is parsed into entries.
+class BodyCatalog {
+private:
+	BodyCatalogView compiled;
+	std::vector<PlanetData> authored;
+
+public:
+	static const size_t npos = BodyCatalogView::npos;
+
+	// Why the last open failed
+	std::string error;
+
+	// Binary catalogs are recognised by their magic, text ones by a .json or .csv extension
+	bool open(const std::string& path) {
+		authored.clear();
+		error.clear();
+		if (compiled.open(path)) return true;
+		compiled.close();
+
+		std::ifstream in(path, std::ios::binary);
+		if (!in) {
+			error = "cannot read " + path;
+			return false;
+		}
+		char magic[sizeof(BODY_CATALOG_MAGIC)] = { 0 };
+		in.read(magic, sizeof(magic));
+		if (std::memcmp(magic, BODY_CATALOG_MAGIC, sizeof(magic)) == 0) {
+			error = "damaged or incompatible catalog " + path;
+			return false;
+		}
+		in.clear();
+		in.seekg(0);
+
+		std::string extension = std::filesystem::path(path).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		bool read = false;
+		if (extension == ".json") {
+			std::stringstream contents;
+			contents << in.rdbuf();
+			std::string text = contents.str();
+			BodyCatalogJSONReader reader(text);
+			read = reader.read(authored);
+			error = reader.error;
+		}
+		else if (extension == ".csv") {
+			read = readBodyCatalogCSV(in, authored, error);
+		}
+		else {
+			error = "unknown catalog format";
+		}
+
+		if (!read) {
+			error = path + ": " + error;
+			authored.clear();
+		}
+		return read;
+	}
+
+	// The built-in solar system
+	void useBuiltIn() {
+		compiled.close();
+		authored = solarSystemCatalog();
+	}
+
+	bool isCompiled() const {
+		return compiled.isOpen();
+	}
+
+	size_t size() const {
+		return compiled.isOpen() ? compiled.size() : authored.size();
+	}
+
+	std::string_view name(size_t i) const {
+		return compiled.isOpen() ? compiled.name(i) : std::string_view(authored[i].name);
+	}
+
+	PlanetData entry(size_t i) const {
+		return compiled.isOpen() ? compiled.entry(i) : authored[i];
+	}
+
+	size_t find(std::string_view wanted) const {
+		if (compiled.isOpen()) return compiled.find(wanted);
+		for (size_t i = 0; i < authored.size(); i++) {
+			if (authored[i].name == wanted) return i;
+		}
+		return npos;
+	}
+
+	size_t addBody(BodySystem& bodies, size_t i) const {
+		return compiled.isOpen() ? compiled.addBody(bodies, i) : addPlanetBody(bodies, authored[i]);
+	}
+
+	// Add every entry, in catalog order
+	void addBodies(BodySystem& bodies) const {
+		const size_t n = size();
+		bodies.reserve(bodies.size() + n);
+		for (size_t i = 0; i < n; i++) addBody(bodies, i);
+	}
+
+	// Write the catalog out in the binary format
+	bool compile(const std::string& path) const {
+		if (!compiled.isOpen()) return writeBodyCatalog(path, authored);
+		std::vector<PlanetData> entries(size());
+		for (size_t i = 0; i < entries.size(); i++) entries[i] = entry(i);
+		return writeBodyCatalog(path, entries);
+	}
+};
+
+#endif
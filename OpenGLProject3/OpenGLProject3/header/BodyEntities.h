@@ -0,0 +1,141 @@
+#ifndef BODYENTITIES_H
+#define BODYENTITIES_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+#include <EntityStore.h>
+#include <PlanetData.h>
+#include <BodySystem.h>
+#include <SolarSystem.h>
+
+// Physics state of an entity: the index of its body in the BodySystem
+struct BodyLink {
+	size_t body = 0;
+};
+
+// Catalog entry of an entity, for its name, colour and orbit
+struct BodyMetadata {
+	PlanetData data;
+};
+
+// Entities for the bodies of one BodySystem. Names are only looked up when an
+// entity is made or searched for; everything after that goes by handle and
+// body index. A removed body's index is handed to the next body added, so the
+// indices of all other bodies, and with them the snapshots, history and
+// checkpoints, never move. Needs no GL context.
+class BodyEntities {
+private:
+	EntityRegistry registry;
+
+	// Owner of each body index, an invalid Entity for a removed body
+	std::vector<Entity> owners;
+	std::vector<size_t> freeBodies;
+
+	std::unordered_map<std::string, Entity> names;
+
+	Entity attach(size_t body, const PlanetData& data) {
+		Entity entity = registry.create();
+		if (body >= owners.size()) owners.resize(body + 1);
+		owners[body] = entity;
+		links.add(entity, BodyLink{ body });
+		metadata.add(entity, BodyMetadata{ data });
+		names.emplace(data.name, entity);
+		return entity;
+	}
+
+public:
+	ComponentArray<BodyLink> links;
+	ComponentArray<BodyMetadata> metadata;
+
+	// An entity for body index body, already in the system
+	Entity adopt(size_t body, const PlanetData& data) {
+		return attach(body, data);
+	}
+
+	// Add the catalog body to the system and make its entity. Only while no
+	// simulation thread owns the system.
+	Entity create(BodySystem& bodies, const PlanetData& data) {
+		return attach(addPlanetBody(bodies, data), data);
+	}
+
+	// Make the entity of a body added while the system is owned elsewhere. The
+	// entity gets a free body index, or the one past the end; the owner of the
+	// system then puts the body there with placePlanetBody.
+	Entity spawn(const PlanetData& data) {
+		size_t body = owners.size();
+		if (!freeBodies.empty()) {
+			body = freeBodies.back();
+			freeBodies.pop_back();
+		}
+		return attach(body, data);
+	}
+
+	// A body index with no entity, e.g. a removed body restored from a
+	// checkpoint. The next spawn gets it.
+	void release(size_t body) {
+		if (body >= owners.size()) owners.resize(body + 1);
+		if (owners[body].valid()) return;
+		freeBodies.push_back(body);
+	}
+
+	// Drop the entity and free its body index, returned through body. The owner
+	// of the system takes the body out with BodySystem::removeBody.
+	bool destroy(Entity entity, size_t& body) {
+		if (!registry.alive(entity)) return false;
+		body = links.get(entity).body;
+
+		auto named = names.find(metadata.get(entity).data.name);
+		if (named != names.end() && named->second == entity) names.erase(named);
+
+		links.remove(entity);
+		metadata.remove(entity);
+		owners[body] = Entity();
+		freeBodies.push_back(body);
+		registry.destroy(entity);
+		return true;
+	}
+
+	bool alive(Entity entity) const {
+		return registry.alive(entity);
+	}
+
+	// Living entities
+	size_t size() const {
+		return registry.size();
+	}
+
+	// Body indices in use or free, the size the system has once every spawn is placed
+	size_t bodyCount() const {
+		return owners.size();
+	}
+
+	size_t body(Entity entity) const {
+		return links.get(entity).body;
+	}
+
+	const PlanetData& data(Entity entity) const {
+		return metadata.get(entity).data;
+	}
+
+	// Entity of a body index, invalid when the index is free or unknown
+	Entity owner(size_t body) const {
+		return body < owners.size() ? owners[body] : Entity();
+	}
+
+	// First entity made with the name, invalid when there is none
+	Entity find(const std::string& name) const {
+		auto named = names.find(name);
+		return named == names.end() ? Entity() : named->second;
+	}
+
+	// Name of the body at an index, empty for a free index
+	std::string_view name(size_t body) const {
+		Entity entity = owner(body);
+		return entity.valid() ? std::string_view(data(entity).name) : std::string_view();
+	}
+};
+
+#endif
@@ -0,0 +1,522 @@
+#ifndef BODYSYSTEM_H
+#define BODYSYSTEM_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <BarnesHut.h>
+#include <GravityKernel.h>
+#include <ThreadPool.h>
+#include <TestParticles.h>
+#include <ForceModel.h>
+
+enum class ForceSolver {
+	Direct,     // all pairs, exact
+	BarnesHut   // octree approximation, see BarnesHut.h
+};
+
+// Structure-of-arrays store for the simulated bodies.
+// Every component lives in its own contiguous array so the force and
+// integration loops stream linearly through memory instead of chasing
+// one heap object per body. State is kept in SI units (m, m/s, kg).
+class BodySystem {
+public:
+	static constexpr double G = 6.67430e-11;
+
+	// Targets per parallel chunk in the force loops, and bodies per chunk in drift and kick
+	static const size_t FORCE_GRAIN = 64;
+	static const size_t UPDATE_GRAIN = 4096;
+
+	// Position
+	std::vector<double> x, y, z;
+
+	// Velocity
+	std::vector<double> vx, vy, vz;
+
+	// Acceleration from the last force evaluation
+	std::vector<double> ax, ay, az;
+
+	// Mass in kg
+	std::vector<double> mass;
+
+	// Physical radius in m, used by collision detection. Zero for point masses.
+	std::vector<double> radius;
+
+	// Massless particles moved along with the bodies by computeAccelerations, drift and kick
+	TestParticles particles;
+
+	// True while ax/ay/az match the current positions
+	bool accelerationsValid = false;
+
+	// Gravitational potential per unit mass of every body (J/kg), stored by the
+	// force passes while potentialRequested is set. Valid while hasPotential().
+	std::vector<double> potential;
+	bool potentialRequested = false;
+	bool potentialValid = false;
+
+	// Force solver used by computeAccelerations
+	ForceSolver forceSolver = ForceSolver::Direct;
+
+	// Barnes-Hut opening angle, smaller is more accurate
+	double openingAngle = 0.5;
+
+	// Below this many bodies the direct sum is faster than building a tree
+	size_t barnesHutMinBodies = 2048;
+
+	// Kernel for the direct sum, the best one the CPU supports by default
+	GravityKernel gravityKernel = detectGravityKernel();
+
+	// Precision of the direct sum; the test particles have their own setting
+	ForcePrecision forcePrecision = ForcePrecision::Double;
+
+	// Force law between the bodies. The test particles always feel plain Newtonian gravity.
+	ForceModel forceModel = ForceModel::Newtonian;
+
+	// Plummer softening length in m
+	double softening = 1e7;
+
+	// Worker threads for the force and integration loops, serial when null.
+	// Every body's result is summed by one thread in a fixed order, so the
+	// state is bit-identical for any thread count.
+	ThreadPool* pool = nullptr;
+
+	// Number of full force evaluations performed, for benchmarking
+	unsigned long long forceEvaluations = 0;
+
+	// Number of single-body acceleration evaluations, a full evaluation counts size()
+	unsigned long long bodyEvaluations = 0;
+
+	size_t size() const {
+		return mass.size();
+	}
+
+	size_t treeNodeCount() const {
+		return tree.nodeCount();
+	}
+
+	void reserve(size_t count) {
+		x.reserve(count); y.reserve(count); z.reserve(count);
+		vx.reserve(count); vy.reserve(count); vz.reserve(count);
+		ax.reserve(count); ay.reserve(count); az.reserve(count);
+		mass.reserve(count);
+		radius.reserve(count);
+	}
+
+	// Append a body and return its index, which stays valid for the lifetime of the system
+	size_t addBody(double m, double px, double py, double pz, double pvx, double pvy, double pvz, double r = 0.0) {
+		x.push_back(px); y.push_back(py); z.push_back(pz);
+		vx.push_back(pvx); vy.push_back(pvy); vz.push_back(pvz);
+		ax.push_back(0.0); ay.push_back(0.0); az.push_back(0.0);
+		mass.push_back(m);
+		radius.push_back(r);
+		accelerationsValid = false;
+		potentialValid = false;
+		return mass.size() - 1;
+	}
+
+	// Overwrite body i, e.g. to reuse the index of a removed body
+	void setBody(size_t i, double m, double px, double py, double pz, double pvx, double pvy, double pvz, double r = 0.0) {
+		x[i] = px; y[i] = py; z[i] = pz;
+		vx[i] = pvx; vy[i] = pvy; vz[i] = pvz;
+		ax[i] = 0.0; ay[i] = 0.0; az[i] = 0.0;
+		mass[i] = m;
+		radius[i] = r;
+		accelerationsValid = false;
+		potentialValid = false;
+	}
+
+	// Take body i out of the simulation. Like a merged body it keeps its index
+	// with zero mass and radius, so no other index moves; it pulls nothing and
+	// collides with nothing until setBody fills the index again.
+	void removeBody(size_t i) {
+		mass[i] = 0.0;
+		radius[i] = 0.0;
+		accelerationsValid = false;
+		potentialValid = false;
+	}
+
+	// Potential from the last force pass still matches the positions
+	bool hasPotential() const {
+		return potentialValid && accelerationsValid;
+	}
+
+	// 1/2 sum m_i phi_i, from the potential stored by the last force pass
+	double potentialEnergy() const {
+		double energy = 0.0;
+		for (size_t i = 0; i < size(); i++) energy += mass[i] * potential[i];
+		return 0.5 * energy;
+	}
+
+	// Evaluate the acceleration of every body from one consistent snapshot of positions,
+	// with the selected solver and force model. Small systems always use the direct sum.
+	void computeAccelerations() {
+		switch (forceModel) {
+		case ForceModel::Plummer: computeAccelerationsWith(PlummerForce(softening)); break;
+		case ForceModel::PostNewtonian: computeAccelerationsWith(PostNewtonianForce()); break;
+		default: computeAccelerationsWith(NewtonianForce()); break;
+		}
+
+		computeParticleAccelerations();
+	}
+
+	// Body accelerations under one force model. The tree and the mixed-precision
+	// sum only know point masses, a softened model always takes the double direct sum.
+	template <class Model>
+	void computeAccelerationsWith(const Model& model) {
+		if (!Model::SOFTENED && forceSolver == ForceSolver::BarnesHut && size() >= barnesHutMinBodies)
+			computeAccelerationsTree();
+		else
+			computeAccelerationsDirect(model);
+
+		if constexpr (Model::POST_NEWTONIAN) addPostNewtonianCorrection();
+	}
+
+	// Pull of the bodies on the test particles at the current positions
+	void computeParticleAccelerations() {
+		if (particles.size() == 0) return;
+		refreshGM();
+		particles.computeAccelerations(x.data(), y.data(), z.data(), gm.data(), size(), pool, gravityKernel);
+	}
+
+	// Exact all-pairs sum. The kernels sum every source for each target, so the
+	// targets split into independent ranges for the pool. Single-threaded the
+	// scalar path instead visits each pair once and applies it to both bodies
+	// (Newton's third law), which is the faster choice without SIMD.
+	template <class Model = NewtonianForce>
+	void computeAccelerationsDirect(const Model& model = Model()) {
+		const size_t n = size();
+		double* pot = preparePotential();
+		if (!Model::SOFTENED && forcePrecision == ForcePrecision::Mixed) {
+			refreshGM();
+			mixedSources.prepare(x.data(), y.data(), z.data(), gm.data(), n);
+
+			forRange(0, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+				runGravityKernelMixed(gravityKernel, mixedSources, begin, end, ax.data(), ay.data(), az.data(), pot);
+			});
+
+			accelerationsValid = true;
+			forceEvaluations++;
+			bodyEvaluations += n;
+			return;
+		}
+
+		if (gravityKernel != GravityKernel::Scalar || pool) {
+			refreshGM();
+
+			forRange(0, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+				runGravityKernel(gravityKernel, x.data(), y.data(), z.data(), gm.data(),
+					n, begin, end, ax.data(), ay.data(), az.data(), pot, model);
+			});
+
+			accelerationsValid = true;
+			forceEvaluations++;
+			bodyEvaluations += n;
+			return;
+		}
+
+		std::fill(ax.begin(), ax.end(), 0.0);
+		std::fill(ay.begin(), ay.end(), 0.0);
+		std::fill(az.begin(), az.end(), 0.0);
+		if (pot) std::fill(potential.begin(), potential.end(), 0.0);
+
+		for (size_t i = 0; i < n; i++) {
+			const double xi = x[i], yi = y[i], zi = z[i];
+			const double mi = mass[i];
+
+			double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+			for (size_t j = i + 1; j < n; j++) {
+				double dx = x[j] - xi;
+				double dy = y[j] - yi;
+				double dz = z[j] - zi;
+				double distSq = dx * dx + dy * dy + dz * dz;
+
+				// Pairs the model leaves out come back as zero
+				double invDist;
+				double s = G * pairInverseCube(model, distSq, invDist);
+
+				// Pull on i towards j, and the equal and opposite pull on j
+				double sj = s * mass[j];
+				sumX += dx * sj;
+				sumY += dy * sj;
+				sumZ += dz * sj;
+
+				double si = s * mi;
+				ax[j] -= dx * si;
+				ay[j] -= dy * si;
+				az[j] -= dz * si;
+
+				if (pot) {
+					double gOverR = G * invDist;
+					pot[i] -= gOverR * mass[j];
+					pot[j] -= gOverR * mi;
+				}
+			}
+
+			ax[i] += sumX;
+			ay[i] += sumY;
+			az[i] += sumZ;
+		}
+
+		accelerationsValid = true;
+		forceEvaluations++;
+		bodyEvaluations += n;
+	}
+
+	// Barnes-Hut approximation, the tree is rebuilt from the current positions
+	void computeAccelerationsTree() {
+		const size_t n = size();
+		double* pot = preparePotential();
+		tree.build(x.data(), y.data(), z.data(), mass.data(), n);
+
+		// Chunks follow the tree order, so each thread walks one region of space
+		forRange(0, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+			tree.computeAccelerations(G, openingAngle, ax.data(), ay.data(), az.data(), begin, end, pot);
+		});
+
+		accelerationsValid = true;
+		forceEvaluations++;
+		bodyEvaluations += n;
+	}
+
+	// Acceleration and its time derivative (jerk) for the listed bodies only,
+	// summed over every other body. Used by schemes that step bodies individually.
+	void computeAccelerationsAndJerk(const std::vector<size_t>& targets,
+		std::vector<double>& jx, std::vector<double>& jy, std::vector<double>& jz) {
+		switch (forceModel) {
+		case ForceModel::Plummer: computeAccelerationsAndJerkWith(PlummerForce(softening), targets, jx, jy, jz); break;
+		case ForceModel::PostNewtonian: computeAccelerationsAndJerkWith(PostNewtonianForce(), targets, jx, jy, jz); break;
+		default: computeAccelerationsAndJerkWith(NewtonianForce(), targets, jx, jy, jz); break;
+		}
+	}
+
+	// The jerk stays Newtonian, the post-Newtonian term only enters the acceleration
+	template <class Model>
+	void computeAccelerationsAndJerkWith(const Model& model, const std::vector<size_t>& targets,
+		std::vector<double>& jx, std::vector<double>& jy, std::vector<double>& jz) {
+		const size_t n = size();
+		const size_t central = Model::POST_NEWTONIAN ? centralBody() : 0;
+
+		forRange(0, targets.size(), FORCE_GRAIN, [&](size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++) {
+				const size_t i = targets[t];
+				const double xi = x[i], yi = y[i], zi = z[i];
+				const double vxi = vx[i], vyi = vy[i], vzi = vz[i];
+
+				double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+				double jerkX = 0.0, jerkY = 0.0, jerkZ = 0.0;
+				for (size_t j = 0; j < n; j++) {
+					if (j == i) continue;
+
+					double dx = x[j] - xi;
+					double dy = y[j] - yi;
+					double dz = z[j] - zi;
+					double distSq = dx * dx + dy * dy + dz * dz;
+
+					if (distSq < model.cutoffSq) continue;
+					if constexpr (Model::SOFTENED) distSq += model.softeningSq;
+
+					double dvx = vx[j] - vxi;
+					double dvy = vy[j] - vyi;
+					double dvz = vz[j] - vzi;
+
+					double invDistSq = 1.0 / distSq;
+					double invDist = std::sqrt(invDistSq);
+					double s = G * mass[j] * invDist * invDistSq;
+					double rv = 3.0 * (dx * dvx + dy * dvy + dz * dvz) * invDistSq;
+
+					sumX += dx * s;
+					sumY += dy * s;
+					sumZ += dz * s;
+
+					jerkX += (dvx - rv * dx) * s;
+					jerkY += (dvy - rv * dy) * s;
+					jerkZ += (dvz - rv * dz) * s;
+				}
+
+				if constexpr (Model::POST_NEWTONIAN) {
+					if (i != central) {
+						addPostNewtonian(G * mass[central], xi - x[central], yi - y[central], zi - z[central],
+							vxi - vx[central], vyi - vy[central], vzi - vz[central], sumX, sumY, sumZ);
+					}
+				}
+
+				ax[i] = sumX; ay[i] = sumY; az[i] = sumZ;
+				jx[i] = jerkX; jy[i] = jerkY; jz[i] = jerkZ;
+			}
+		});
+
+		potentialValid = false;
+		bodyEvaluations += targets.size();
+	}
+
+	// Move every body and particle along its velocity
+	void drift(double dt) {
+		forRange(0, size(), UPDATE_GRAIN, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				x[i] += vx[i] * dt;
+				y[i] += vy[i] * dt;
+				z[i] += vz[i] * dt;
+			}
+		});
+		particles.drift(dt, pool);
+		accelerationsValid = false;
+	}
+
+	// Change every body and particle velocity by the stored accelerations
+	void kick(double dt) {
+		forRange(0, size(), UPDATE_GRAIN, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				vx[i] += ax[i] * dt;
+				vy[i] += ay[i] * dt;
+				vz[i] += az[i] * dt;
+			}
+		});
+		particles.kick(dt, pool);
+	}
+
+	// Kinetic plus potential energy, O(N^2). Summed per chunk of bodies and the
+	// chunks added in order, so the value does not depend on the thread count.
+	// Uses the softened potential under the Plummer model.
+	double totalEnergy() const {
+		const size_t n = size();
+		const double softeningSq = forceModel == ForceModel::Plummer ? softening * softening : 0.0;
+		std::vector<double> partial((n + FORCE_GRAIN - 1) / FORCE_GRAIN, 0.0);
+
+		forRange(0, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+			double kineticSum = 0.0;
+			double potentialSum = 0.0;
+			for (size_t i = begin; i < end; i++) {
+				kineticSum += 0.5 * mass[i] * (vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+
+				for (size_t j = i + 1; j < n; j++) {
+					double dx = x[j] - x[i];
+					double dy = y[j] - y[i];
+					double dz = z[j] - z[i];
+					potentialSum -= G * mass[i] * mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz + softeningSq);
+				}
+			}
+			partial[begin / FORCE_GRAIN] = kineticSum + potentialSum;
+		});
+
+		double energy = 0.0;
+		for (double value : partial) energy += value;
+		return energy;
+	}
+
+	// Run body(chunkBegin, chunkEnd) over [begin, end) on the pool, or inline without one
+	template <class F>
+	void forRange(size_t begin, size_t end, size_t grain, F body) const {
+		if (pool)
+			pool->parallelFor(begin, end, grain, body);
+		else
+			for (size_t b = begin; b < end; b += grain) body(b, std::min(end, b + grain));
+	}
+
+	// Pairwise accelerations of size() bodies at positions sx, sy, sz with masses
+	// sm (and gm = G * sm), written to ox, oy, oz, with the same solver, kernel,
+	// precision and pool as computeAccelerations. For schemes that evaluate the
+	// forces in their own coordinates, such as the Wisdom-Holman heliocentric
+	// kick; a body given zero mass pulls nothing. No post-Newtonian term.
+	template <class Model>
+	void computeAccelerationsAt(const Model& model, const double* sx, const double* sy, const double* sz,
+		const double* sm, const double* sgm, double* ox, double* oy, double* oz) {
+		const size_t n = size();
+		if (!Model::SOFTENED && forceSolver == ForceSolver::BarnesHut && n >= barnesHutMinBodies) {
+			tree.build(sx, sy, sz, sm, n);
+			forRange(0, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+				tree.computeAccelerations(G, openingAngle, ox, oy, oz, begin, end);
+			});
+		}
+		else if (!Model::SOFTENED && forcePrecision == ForcePrecision::Mixed) {
+			mixedSources.prepare(sx, sy, sz, sgm, n);
+			forRange(0, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+				runGravityKernelMixed(gravityKernel, mixedSources, begin, end, ox, oy, oz);
+			});
+		}
+		else if (gravityKernel != GravityKernel::Scalar || pool) {
+			forRange(0, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+				runGravityKernel(gravityKernel, sx, sy, sz, sgm, n, begin, end, ox, oy, oz, nullptr, model);
+			});
+		}
+		else {
+			// Single-threaded scalar: each pair once, as in computeAccelerationsDirect
+			std::fill(ox, ox + n, 0.0);
+			std::fill(oy, oy + n, 0.0);
+			std::fill(oz, oz + n, 0.0);
+			for (size_t i = 0; i < n; i++) {
+				for (size_t j = i + 1; j < n; j++) {
+					double dx = sx[j] - sx[i];
+					double dy = sy[j] - sy[i];
+					double dz = sz[j] - sz[i];
+					double invDist;
+					double s = G * pairInverseCube(model, dx * dx + dy * dy + dz * dz, invDist);
+
+					double sj = s * sm[j];
+					ox[i] += dx * sj; oy[i] += dy * sj; oz[i] += dz * sj;
+					double si = s * sm[i];
+					ox[j] -= dx * si; oy[j] -= dy * si; oz[j] -= dz * si;
+				}
+			}
+		}
+
+		forceEvaluations++;
+		bodyEvaluations += n;
+	}
+
+private:
+	BarnesHutTree tree;
+
+	// G * mass, refreshed for every SIMD and particle evaluation
+	std::vector<double> gm;
+
+	// Float copy of the bodies for the mixed-precision direct sum
+	MixedPrecisionSources mixedSources;
+
+	// Storage for this pass's potential, or null when it was not requested
+	double* preparePotential() {
+		potentialValid = potentialRequested;
+		if (!potentialRequested) return nullptr;
+		potential.resize(size());
+		return potential.data();
+	}
+
+	// Most massive body, the source of the post-Newtonian correction
+	size_t centralBody() const {
+		return static_cast<size_t>(std::max_element(mass.begin(), mass.end()) - mass.begin());
+	}
+
+	// 1PN pull of the central body on every other body, relative to the central
+	// body's position and velocity. The central body takes the reaction scaled by
+	// mass, so the total momentum change stays zero.
+	void addPostNewtonianCorrection() {
+		const size_t n = size();
+		if (n < 2) return;
+		const size_t c = centralBody();
+		const double mu = G * mass[c];
+
+		double reactionX = 0.0, reactionY = 0.0, reactionZ = 0.0;
+		for (size_t i = 0; i < n; i++) {
+			if (i == c) continue;
+			double dax = 0.0, day = 0.0, daz = 0.0;
+			addPostNewtonian(mu, x[i] - x[c], y[i] - y[c], z[i] - z[c],
+				vx[i] - vx[c], vy[i] - vy[c], vz[i] - vz[c], dax, day, daz);
+			ax[i] += dax; ay[i] += day; az[i] += daz;
+
+			reactionX -= dax * mass[i];
+			reactionY -= day * mass[i];
+			reactionZ -= daz * mass[i];
+		}
+		ax[c] += reactionX / mass[c];
+		ay[c] += reactionY / mass[c];
+		az[c] += reactionZ / mass[c];
+	}
+
+	void refreshGM() {
+		const size_t n = size();
+		gm.resize(n);
+		for (size_t i = 0; i < n; i++) gm[i] = G * mass[i];
+	}
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef CAMERABUFFER_H
+#define CAMERABUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <Shader.h>
+
+// View and projection in one uniform buffer, uploaded once per frame and read
+// by every program that declares
+//
+//   layout(std140) uniform Camera { mat4 view; mat4 projection; };
+//
+// The Shader binds such a block to CAMERA_BLOCK_BINDING when it is linked.
+class CameraBuffer {
+public:
+	GLuint uboId = 0;
+
+	CameraBuffer() {
+		glGenBuffers(1, &uboId);
+		glBindBuffer(GL_UNIFORM_BUFFER, uboId);
+		glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, uboId);
+	}
+
+	~CameraBuffer() {
+		glDeleteBuffers(1, &uboId);
+	}
+
+	CameraBuffer(const CameraBuffer&) = delete;
+	CameraBuffer& operator=(const CameraBuffer&) = delete;
+
+	// std140 lays two mat4 out back to back, column major like glm
+	void update(const glm::mat4& view, const glm::mat4& projection) {
+		glBindBuffer(GL_UNIFORM_BUFFER, uboId);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(view));
+		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(projection));
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+};
+
+#endif
@@ -0,0 +1,547 @@
+#ifndef CHEBYSHEVTABLE_H
+#define CHEBYSHEVTABLE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <MappedFile.h>
+#include <BodySystem.h>
+#include <Units.h>
+
+// Reference ephemeris as Chebyshev polynomials, the way JPL's DE files store
+// planets: each body's span is cut into equal segments and each segment holds
+// one polynomial per axis in tau = 2 (t - segment start) / length - 1. A
+// position is one segment lookup and a short recurrence, far cheaper than
+// integrating up to the epoch.
+//
+// Times are TDB seconds since J2000, positions in m relative to the table's
+// centre body (usually the Sun), as exported.
+//
+// Binary layout, all little-endian:
+//   ChebyshevTableHeader
+//   bodies:       bodyCount ChebyshevBodyRecord
+//   coefficients: per body, per segment, x then y then z, coefficientCount doubles each
+//   strings:      body and centre names, not terminated
+// Every section starts on a 64 byte boundary, the file is mapped and read in place.
+const char CHEBYSHEV_TABLE_MAGIC[8] = { 'N', 'B', 'O', 'D', 'Y', 'C', 'H', 'B' };
+const uint32_t CHEBYSHEV_TABLE_VERSION = 1;
+const uint32_t CHEBYSHEV_TABLE_BYTE_ORDER = 0x01020304;
+const size_t CHEBYSHEV_TABLE_ALIGN = 64;
+
+// Highest supported number of coefficients per axis
+const size_t CHEBYSHEV_MAX_COEFFICIENTS = 32;
+
+const double J2000_JULIAN_DATE = 2451545.0;
+
+// TDB seconds since J2000 of a Julian date
+inline double julianDateToSeconds(double julianDate) {
+	return Seconds(Days(julianDate - J2000_JULIAN_DATE)).value();
+}
+
+struct ChebyshevTableHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t fileSize;
+	uint64_t bodyCount;
+	uint64_t bodyOffset;
+	uint64_t coefficientOffset;
+	uint64_t coefficientTotal;   // doubles in the coefficient section
+	uint64_t stringOffset;
+	uint64_t stringBytes;
+	uint32_t centerOffset;
+	uint32_t centerLength;
+	uint64_t reserved[6];
+};
+
+struct ChebyshevBodyRecord {
+	double start;              // s since J2000, start of the first segment
+	double segmentSeconds;
+	uint64_t segmentCount;
+	uint64_t coefficientIndex; // first double of this body in the coefficient section
+	double maxError;           // largest fit residual against the samples, m
+	uint32_t coefficientCount; // per axis and segment
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t padding;
+};
+
+static_assert(sizeof(ChebyshevTableHeader) == 128, "chebyshev table header layout changed");
+static_assert(sizeof(ChebyshevBodyRecord) == 56, "chebyshev body record layout changed");
+
+inline uint64_t alignChebyshevOffset(uint64_t offset) {
+	return (offset + CHEBYSHEV_TABLE_ALIGN - 1) / CHEBYSHEV_TABLE_ALIGN * CHEBYSHEV_TABLE_ALIGN;
+}
+
+// Chebyshev polynomials T_k(tau) and their derivatives for k < count
+inline void chebyshevBasis(double tau, size_t count, double* t, double* dt) {
+	t[0] = 1.0;
+	dt[0] = 0.0;
+	if (count > 1) {
+		t[1] = tau;
+		dt[1] = 1.0;
+	}
+	for (size_t k = 2; k < count; k++) {
+		t[k] = 2.0 * tau * t[k - 1] - t[k - 2];
+		dt[k] = 2.0 * t[k - 1] + 2.0 * tau * dt[k - 1] - dt[k - 2];
+	}
+}
+
+// Sum of c_k T_k(tau), Clenshaw's recurrence
+inline double chebyshevSeries(const double* c, size_t count, double tau) {
+	double b1 = 0.0, b2 = 0.0;
+	for (size_t k = count - 1; k > 0; k--) {
+		double b = 2.0 * tau * b1 - b2 + c[k];
+		b2 = b1;
+		b1 = b;
+	}
+	return tau * b1 - b2 + c[0];
+}
+
+// The same series at N values of tau with one set of coefficients. The loop
+// over tau is innermost and has a fixed length, so it vectorizes without a
+// scalar remainder.
+template <size_t N>
+inline void chebyshevSeriesBatch(const double* __restrict c, size_t count,
+	const double* __restrict tau, double* __restrict out) {
+	double b1[N], b2[N];
+	for (size_t j = 0; j < N; j++) {
+		b1[j] = 0.0;
+		b2[j] = 0.0;
+	}
+	for (size_t k = count - 1; k > 0; k--) {
+		const double ck = c[k];
+		for (size_t j = 0; j < N; j++) {
+			double b = 2.0 * tau[j] * b1[j] - b2[j] + ck;
+			b2[j] = b1[j];
+			b1[j] = b;
+		}
+	}
+	for (size_t j = 0; j < N; j++) out[j] = tau[j] * b1[j] - b2[j] + c[0];
+}
+
+// Sampled states of one body, SI units, times in s since J2000 and increasing
+struct EphemerisSamples {
+	std::string name;
+	std::string center;
+	std::vector<double> t;
+	std::vector<double> x, y, z;
+	std::vector<double> vx, vy, vz;
+
+	size_t size() const {
+		return t.size();
+	}
+};
+
+// One body's segments before they are written
+struct ChebyshevFit {
+	std::string name;
+	double start = 0.0;
+	double segmentSeconds = 0.0;
+	size_t segmentCount = 0;
+	size_t coefficientCount = 0;
+	std::vector<double> coefficients;
+	double maxError = 0.0;
+};
+
+// Least-squares fit of segments of about segmentSeconds with coefficientCount
+// coefficients per axis. The length is shortened so whole segments tile the
+// sampled span exactly. Positions and velocities both enter the fit (the
+// velocity scaled by length / 2, as d/dtau), so a segment needs only half as
+// many samples as coefficients. Returns false for too few samples.
+inline bool fitChebyshev(const EphemerisSamples& samples, double segmentSeconds, size_t coefficientCount,
+	ChebyshevFit& fit, std::string& error) {
+	const size_t m = coefficientCount;
+	if (m < 2 || m > CHEBYSHEV_MAX_COEFFICIENTS) {
+		error = "between 2 and " + std::to_string(CHEBYSHEV_MAX_COEFFICIENTS) + " coefficients are supported";
+		return false;
+	}
+	if (samples.size() < 2 || !(segmentSeconds > 0.0)) {
+		error = samples.name + ": too few samples";
+		return false;
+	}
+
+	const double start = samples.t.front();
+	const double span = samples.t.back() - start;
+	fit.name = samples.name;
+	fit.start = start;
+	fit.segmentCount = std::max<size_t>(1, static_cast<size_t>(std::ceil(span / segmentSeconds - 1e-9)));
+	fit.segmentSeconds = span / fit.segmentCount;
+	fit.coefficientCount = m;
+	fit.coefficients.assign(fit.segmentCount * 3 * m, 0.0);
+	fit.maxError = 0.0;
+
+	const double* positions[3] = { samples.x.data(), samples.y.data(), samples.z.data() };
+	const double* velocities[3] = { samples.vx.data(), samples.vy.data(), samples.vz.data() };
+	double t[CHEBYSHEV_MAX_COEFFICIENTS], dt[CHEBYSHEV_MAX_COEFFICIENTS];
+
+	size_t first = 0;
+	for (size_t s = 0; s < fit.segmentCount; s++) {
+		const double segmentStart = start + s * fit.segmentSeconds;
+		const double segmentEnd = segmentStart + fit.segmentSeconds;
+		const double halfLength = 0.5 * fit.segmentSeconds;
+
+		// Samples on both boundaries belong to both neighbours
+		while (first < samples.size() && samples.t[first] < segmentStart - 1e-6 * fit.segmentSeconds) first++;
+		size_t last = first;
+		while (last < samples.size() && samples.t[last] <= segmentEnd + 1e-6 * fit.segmentSeconds) last++;
+		if (2 * (last - first) < m) {
+			error = samples.name + ": segment " + std::to_string(s) + " has too few samples for "
+				+ std::to_string(m) + " coefficients";
+			return false;
+		}
+
+		// Normal equations, shared by the three axes
+		double normal[CHEBYSHEV_MAX_COEFFICIENTS][CHEBYSHEV_MAX_COEFFICIENTS] = {};
+		double rhs[3][CHEBYSHEV_MAX_COEFFICIENTS] = {};
+		for (size_t i = first; i < last; i++) {
+			const double tau = std::clamp((samples.t[i] - segmentStart) / halfLength - 1.0, -1.0, 1.0);
+			chebyshevBasis(tau, m, t, dt);
+			for (size_t a = 0; a < m; a++) {
+				for (size_t b = 0; b < m; b++) normal[a][b] += t[a] * t[b] + dt[a] * dt[b];
+				for (int axis = 0; axis < 3; axis++) {
+					rhs[axis][a] += t[a] * positions[axis][i] + dt[a] * velocities[axis][i] * halfLength;
+				}
+			}
+		}
+
+		// Cholesky factorisation, the matrix is symmetric positive definite
+		for (size_t a = 0; a < m; a++) {
+			for (size_t b = 0; b <= a; b++) {
+				double sum = normal[a][b];
+				for (size_t k = 0; k < b; k++) sum -= normal[a][k] * normal[b][k];
+				if (a == b) {
+					if (!(sum > 0.0)) {
+						error = samples.name + ": segment " + std::to_string(s) + " cannot be fitted";
+						return false;
+					}
+					normal[a][a] = std::sqrt(sum);
+				}
+				else {
+					normal[a][b] = sum / normal[b][b];
+				}
+			}
+		}
+
+		double* segment = fit.coefficients.data() + s * 3 * m;
+		for (int axis = 0; axis < 3; axis++) {
+			double* c = segment + axis * m;
+			for (size_t a = 0; a < m; a++) {
+				double sum = rhs[axis][a];
+				for (size_t k = 0; k < a; k++) sum -= normal[a][k] * c[k];
+				c[a] = sum / normal[a][a];
+			}
+			for (size_t a = m; a-- > 0;) {
+				double sum = c[a];
+				for (size_t k = a + 1; k < m; k++) sum -= normal[k][a] * c[k];
+				c[a] = sum / normal[a][a];
+			}
+		}
+
+		for (size_t i = first; i < last; i++) {
+			const double tau = std::clamp((samples.t[i] - segmentStart) / halfLength - 1.0, -1.0, 1.0);
+			double distSq = 0.0;
+			for (int axis = 0; axis < 3; axis++) {
+				double d = chebyshevSeries(segment + axis * m, m, tau) - positions[axis][i];
+				distSq += d * d;
+			}
+			fit.maxError = std::max(fit.maxError, std::sqrt(distSq));
+		}
+
+		// The next segment starts with this one's end sample
+		if (last > first) first = last - 1;
+	}
+	return true;
+}
+
+// Write fitted bodies as a table, through path + ".tmp" and a rename like checkpoints
+inline bool writeChebyshevTable(const std::string& path, const std::string& center, const std::vector<ChebyshevFit>& fits) {
+	std::vector<ChebyshevBodyRecord> records(fits.size());
+	std::string strings = center;
+	uint64_t coefficientTotal = 0;
+	for (size_t b = 0; b < fits.size(); b++) {
+		ChebyshevBodyRecord& record = records[b];
+		std::memset(&record, 0, sizeof(record));
+		record.start = fits[b].start;
+		record.segmentSeconds = fits[b].segmentSeconds;
+		record.segmentCount = fits[b].segmentCount;
+		record.coefficientIndex = coefficientTotal;
+		record.maxError = fits[b].maxError;
+		record.coefficientCount = static_cast<uint32_t>(fits[b].coefficientCount);
+		record.nameOffset = static_cast<uint32_t>(strings.size());
+		record.nameLength = static_cast<uint32_t>(fits[b].name.size());
+		strings += fits[b].name;
+		coefficientTotal += fits[b].coefficients.size();
+	}
+
+	ChebyshevTableHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, CHEBYSHEV_TABLE_MAGIC, sizeof(header.magic));
+	header.version = CHEBYSHEV_TABLE_VERSION;
+	header.byteOrder = CHEBYSHEV_TABLE_BYTE_ORDER;
+	header.bodyCount = fits.size();
+	header.bodyOffset = alignChebyshevOffset(sizeof(ChebyshevTableHeader));
+	header.coefficientOffset = alignChebyshevOffset(header.bodyOffset + fits.size() * sizeof(ChebyshevBodyRecord));
+	header.coefficientTotal = coefficientTotal;
+	header.stringOffset = alignChebyshevOffset(header.coefficientOffset + coefficientTotal * sizeof(double));
+	header.stringBytes = strings.size();
+	header.centerOffset = 0;
+	header.centerLength = static_cast<uint32_t>(center.size());
+	header.fileSize = header.stringOffset + header.stringBytes;
+
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		uint64_t written = 0;
+		auto put = [&](const void* bytes, uint64_t length) {
+			out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(length));
+			written += length;
+		};
+		auto padTo = [&](uint64_t offset) {
+			static const char zeros[CHEBYSHEV_TABLE_ALIGN] = { 0 };
+			if (offset > written) put(zeros, offset - written);
+		};
+
+		put(&header, sizeof(header));
+		padTo(header.bodyOffset);
+		put(records.data(), records.size() * sizeof(ChebyshevBodyRecord));
+		padTo(header.coefficientOffset);
+		for (const ChebyshevFit& fit : fits) put(fit.coefficients.data(), fit.coefficients.size() * sizeof(double));
+		padTo(header.stringOffset);
+		put(strings.data(), strings.size());
+
+		if (!out) return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	return !error;
+}
+
+// A Chebyshev table mapped into memory and evaluated in place. Outside a body's
+// span the nearest end of it is returned, the polynomials are never extrapolated.
+class ChebyshevTable {
+private:
+	MappedFile file;
+	const ChebyshevTableHeader* header = nullptr;
+
+	// Epochs per batch in positions(), sized to stay in L1 with its scratch
+	static const size_t BATCH = 64;
+
+	const double* coefficients() const {
+		return reinterpret_cast<const double*>(file.data() + header->coefficientOffset);
+	}
+
+	std::string_view string(uint32_t offset, uint32_t length) const {
+		if (uint64_t(offset) + length > header->stringBytes) return std::string_view();
+		return std::string_view(reinterpret_cast<const char*>(file.data() + header->stringOffset) + offset, length);
+	}
+
+	// Segment covering time and tau inside it
+	size_t segmentAt(const ChebyshevBodyRecord& r, double time, double& tau) const {
+		double u = (time - r.start) / r.segmentSeconds;
+		double s = std::clamp(std::floor(u), 0.0, static_cast<double>(r.segmentCount - 1));
+		tau = std::clamp(2.0 * (u - s) - 1.0, -1.0, 1.0);
+		return static_cast<size_t>(s);
+	}
+
+	const double* segmentCoefficients(const ChebyshevBodyRecord& r, size_t s) const {
+		return coefficients() + r.coefficientIndex + s * 3 * r.coefficientCount;
+	}
+
+public:
+	static const size_t npos = static_cast<size_t>(-1);
+
+	// Maps the file and checks that every section lies inside it
+	bool open(const std::string& path) {
+		header = nullptr;
+		if (!file.open(path) || file.size() < sizeof(ChebyshevTableHeader)) return false;
+
+		const ChebyshevTableHeader* candidate = reinterpret_cast<const ChebyshevTableHeader*>(file.data());
+		if (std::memcmp(candidate->magic, CHEBYSHEV_TABLE_MAGIC, sizeof(CHEBYSHEV_TABLE_MAGIC)) != 0) return false;
+		if (candidate->version != CHEBYSHEV_TABLE_VERSION) return false;
+		if (candidate->byteOrder != CHEBYSHEV_TABLE_BYTE_ORDER) return false;
+		if (candidate->fileSize != file.size()) return false;
+		if (candidate->bodyCount > file.size() / sizeof(ChebyshevBodyRecord)) return false;
+		if (candidate->coefficientTotal > file.size() / sizeof(double)) return false;
+		// Offsets no larger than the file, so the section ends below cannot wrap
+		if (candidate->bodyOffset > file.size() || candidate->coefficientOffset > file.size()) return false;
+		if (candidate->stringOffset > file.size() || candidate->stringBytes > file.size()) return false;
+
+		const uint64_t bodyEnd = candidate->bodyOffset + candidate->bodyCount * sizeof(ChebyshevBodyRecord);
+		const uint64_t coefficientEnd = candidate->coefficientOffset + candidate->coefficientTotal * sizeof(double);
+		if (candidate->bodyOffset % CHEBYSHEV_TABLE_ALIGN != 0 || bodyEnd > candidate->coefficientOffset) return false;
+		if (candidate->coefficientOffset % CHEBYSHEV_TABLE_ALIGN != 0 || coefficientEnd > candidate->stringOffset) return false;
+		if (candidate->stringOffset + candidate->stringBytes > file.size()) return false;
+
+		// Few bodies, so every record is checked against the coefficient section up front
+		const ChebyshevBodyRecord* records = reinterpret_cast<const ChebyshevBodyRecord*>(file.data() + candidate->bodyOffset);
+		for (uint64_t b = 0; b < candidate->bodyCount; b++) {
+			const ChebyshevBodyRecord& r = records[b];
+			if (r.coefficientCount < 2 || r.coefficientCount > CHEBYSHEV_MAX_COEFFICIENTS) return false;
+			if (r.segmentCount == 0 || !(r.segmentSeconds > 0.0)) return false;
+			if (r.segmentCount > candidate->coefficientTotal) return false;
+			if (r.coefficientIndex > candidate->coefficientTotal) return false;
+			if (r.segmentCount * 3 * r.coefficientCount > candidate->coefficientTotal - r.coefficientIndex) return false;
+		}
+
+		header = candidate;
+		return true;
+	}
+
+	bool isOpen() const {
+		return header != nullptr;
+	}
+
+	size_t size() const {
+		return header ? static_cast<size_t>(header->bodyCount) : 0;
+	}
+
+	const ChebyshevBodyRecord& body(size_t b) const {
+		return reinterpret_cast<const ChebyshevBodyRecord*>(file.data() + header->bodyOffset)[b];
+	}
+
+	std::string_view name(size_t b) const {
+		return string(body(b).nameOffset, body(b).nameLength);
+	}
+
+	// Body the positions are relative to
+	std::string_view center() const {
+		return string(header->centerOffset, header->centerLength);
+	}
+
+	size_t find(std::string_view wanted) const {
+		for (size_t b = 0; b < size(); b++) {
+			if (name(b) == wanted) return b;
+		}
+		return npos;
+	}
+
+	double startTime(size_t b) const {
+		return body(b).start;
+	}
+
+	double endTime(size_t b) const {
+		return body(b).start + body(b).segmentSeconds * body(b).segmentCount;
+	}
+
+	// Position of body b at time, m
+	void position(size_t b, double time, double out[3]) const {
+		const ChebyshevBodyRecord& r = body(b);
+		double tau;
+		const double* c = segmentCoefficients(r, segmentAt(r, time, tau));
+		const size_t m = r.coefficientCount;
+		for (int axis = 0; axis < 3; axis++) out[axis] = chebyshevSeries(c + axis * m, m, tau);
+	}
+
+	// Position and velocity of body b at time, m and m/s
+	void state(size_t b, double time, double position[3], double velocity[3]) const {
+		const ChebyshevBodyRecord& r = body(b);
+		double tau;
+		const double* c = segmentCoefficients(r, segmentAt(r, time, tau));
+		const size_t m = r.coefficientCount;
+
+		double t[CHEBYSHEV_MAX_COEFFICIENTS], dt[CHEBYSHEV_MAX_COEFFICIENTS];
+		chebyshevBasis(tau, m, t, dt);
+		const double dTauDt = 2.0 / r.segmentSeconds;
+		for (int axis = 0; axis < 3; axis++) {
+			double p = 0.0, v = 0.0;
+			for (size_t k = 0; k < m; k++) {
+				p += c[axis * m + k] * t[k];
+				v += c[axis * m + k] * dt[k];
+			}
+			position[axis] = p;
+			velocity[axis] = v * dTauDt;
+		}
+	}
+
+	// Positions of body b at count epochs. Runs of epochs in one segment are
+	// evaluated together by chebyshevSeriesBatch, so sorted epochs vectorize.
+	void positions(size_t b, const double* times, size_t count, double* x, double* y, double* z) const {
+		const ChebyshevBodyRecord& r = body(b);
+		const size_t m = r.coefficientCount;
+		double tau[BATCH], values[BATCH];
+		double* out[3] = { x, y, z };
+
+		size_t j = 0;
+		while (j < count) {
+			double firstTau;
+			const size_t s = segmentAt(r, times[j], firstTau);
+			tau[0] = firstTau;
+			size_t run = 1;
+			while (run < BATCH && j + run < count) {
+				double nextTau;
+				if (segmentAt(r, times[j + run], nextTau) != s) break;
+				tau[run++] = nextTau;
+			}
+
+			// A short run repeats its last epoch, so the batch always has the full length
+			for (size_t k = run; k < BATCH; k++) tau[k] = tau[run - 1];
+
+			const double* c = segmentCoefficients(r, s);
+			for (int axis = 0; axis < 3; axis++) {
+				chebyshevSeriesBatch<BATCH>(c + axis * m, m, tau, values);
+				std::copy(values, values + run, out[axis] + j);
+			}
+			j += run;
+		}
+	}
+};
+
+// Start bodies from the table at time, e.g. at a real date. nameOf(i) gives
+// body i's name; bodies the table does not know keep their state, the centre
+// body is put at the origin at rest. The system is then moved to its
+// barycentric frame so it does not drift as a whole. Returns the bodies set.
+template <class NameOf>
+size_t setEphemerisStates(const ChebyshevTable& table, BodySystem& bodies, double time, NameOf nameOf) {
+	const size_t n = bodies.size();
+	size_t set = 0;
+	for (size_t i = 0; i < n; i++) {
+		std::string_view name = nameOf(i);
+		double position[3] = { 0.0, 0.0, 0.0 }, velocity[3] = { 0.0, 0.0, 0.0 };
+		if (name != table.center()) {
+			size_t b = table.find(name);
+			if (b == ChebyshevTable::npos) continue;
+			table.state(b, time, position, velocity);
+		}
+		bodies.x[i] = position[0]; bodies.y[i] = position[1]; bodies.z[i] = position[2];
+		bodies.vx[i] = velocity[0]; bodies.vy[i] = velocity[1]; bodies.vz[i] = velocity[2];
+		set++;
+	}
+
+	double totalMass = 0.0;
+	double cm[6] = { 0.0 };
+	for (size_t i = 0; i < n; i++) {
+		const double m = bodies.mass[i];
+		totalMass += m;
+		cm[0] += m * bodies.x[i]; cm[1] += m * bodies.y[i]; cm[2] += m * bodies.z[i];
+		cm[3] += m * bodies.vx[i]; cm[4] += m * bodies.vy[i]; cm[5] += m * bodies.vz[i];
+	}
+	if (totalMass > 0.0) {
+		for (double& value : cm) value /= totalMass;
+		for (size_t i = 0; i < n; i++) {
+			bodies.x[i] -= cm[0]; bodies.y[i] -= cm[1]; bodies.z[i] -= cm[2];
+			bodies.vx[i] -= cm[3]; bodies.vy[i] -= cm[4]; bodies.vz[i] -= cm[5];
+		}
+		TestParticles& particles = bodies.particles;
+		for (size_t i = 0; i < particles.size(); i++) {
+			particles.x[i] -= cm[0]; particles.y[i] -= cm[1]; particles.z[i] -= cm[2];
+			particles.vx[i] -= cm[3]; particles.vy[i] -= cm[4]; particles.vz[i] -= cm[5];
+		}
+	}
+
+	bodies.accelerationsValid = false;
+	bodies.potentialValid = false;
+	return set;
+}
+
+#endif
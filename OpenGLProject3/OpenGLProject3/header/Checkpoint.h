@@ -0,0 +1,288 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <BodySystem.h>
+#include <MappedFile.h>
+
+// Binary checkpoint of a whole run. Layout, all little-endian:
+//   CheckpointHeader
+//   bodies:    x, y, z, vx, vy, vz, mass, radius   (bodyCount doubles each)
+//   particles: x, y, z, vx, vy, vz         (particleCount doubles each)
+//   trails:    per trail a CheckpointTrailRecord, then vertexCount * 6 floats
+// Every section starts on a 64 byte boundary, so once the file is mapped the
+// arrays can be used in place without any parsing.
+const char CHECKPOINT_MAGIC[8] = { 'N', 'B', 'O', 'D', 'Y', 'C', 'P', '\0' };
+const uint32_t CHECKPOINT_VERSION = 2;
+const uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+const size_t CHECKPOINT_ALIGN = 64;
+
+const size_t CHECKPOINT_BODY_ARRAYS = 8;
+const size_t CHECKPOINT_PARTICLE_ARRAYS = 6;
+
+// Floats per trail vertex: position xyz, texture coordinate uv, visibility
+const size_t CHECKPOINT_TRAIL_VERTEX_FLOATS = 6;
+
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t fileSize;
+	double simTime;
+	uint64_t bodyCount;
+	uint64_t particleCount;
+	uint64_t trailCount;
+	uint64_t bodyOffset;
+	uint64_t particleOffset;
+	uint64_t trailOffset;
+	uint64_t reserved[6];
+};
+
+struct CheckpointTrailRecord {
+	uint32_t vertexCount;
+	int32_t segmentsUsed;
+	float last[3];
+	uint32_t padding;
+};
+
+static_assert(sizeof(CheckpointHeader) == 128, "checkpoint header layout changed");
+static_assert(sizeof(CheckpointTrailRecord) == 24, "checkpoint trail record layout changed");
+
+// Trail contents, filled by the renderer since trails live with the planets
+struct CheckpointTrail {
+	int segmentsUsed = 0;
+	float last[3] = { 0.0f, 0.0f, 0.0f };
+	std::vector<float> vertices;
+};
+
+// Copy of everything a checkpoint holds, taken at one instant so it can be
+// written out while the simulation carries on
+struct CheckpointData {
+	double simTime = 0.0;
+	std::vector<double> x, y, z, vx, vy, vz, mass, radius;
+	std::vector<double> px, py, pz, pvx, pvy, pvz;
+	std::vector<CheckpointTrail> trails;
+};
+
+// Body and particle state, the trails are left as they are
+inline void captureCheckpoint(const BodySystem& bodies, double simTime, CheckpointData& data) {
+	data.simTime = simTime;
+	data.x = bodies.x; data.y = bodies.y; data.z = bodies.z;
+	data.vx = bodies.vx; data.vy = bodies.vy; data.vz = bodies.vz;
+	data.mass = bodies.mass;
+	data.radius = bodies.radius;
+
+	const TestParticles& particles = bodies.particles;
+	data.px = particles.x; data.py = particles.y; data.pz = particles.z;
+	data.pvx = particles.vx; data.pvy = particles.vy; data.pvz = particles.vz;
+}
+
+inline uint64_t alignCheckpointOffset(uint64_t offset) {
+	return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+// Write to path + ".tmp" and rename, so a crash never leaves a torn checkpoint behind
+inline bool writeCheckpoint(const std::string& path, const CheckpointData& data) {
+	const uint64_t bodyCount = data.mass.size();
+	const uint64_t particleCount = data.px.size();
+
+	CheckpointHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.byteOrder = CHECKPOINT_BYTE_ORDER;
+	header.simTime = data.simTime;
+	header.bodyCount = bodyCount;
+	header.particleCount = particleCount;
+	header.trailCount = data.trails.size();
+
+	header.bodyOffset = alignCheckpointOffset(sizeof(CheckpointHeader));
+	header.particleOffset = alignCheckpointOffset(header.bodyOffset + CHECKPOINT_BODY_ARRAYS * bodyCount * sizeof(double));
+	header.trailOffset = alignCheckpointOffset(header.particleOffset + CHECKPOINT_PARTICLE_ARRAYS * particleCount * sizeof(double));
+
+	uint64_t trailBytes = 0;
+	for (const CheckpointTrail& trail : data.trails) {
+		trailBytes += sizeof(CheckpointTrailRecord) + trail.vertices.size() * sizeof(float);
+	}
+	header.fileSize = header.trailOffset + trailBytes;
+
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		uint64_t written = 0;
+		auto put = [&](const void* bytes, uint64_t count) {
+			out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(count));
+			written += count;
+		};
+		auto padTo = [&](uint64_t offset) {
+			static const char zeros[CHECKPOINT_ALIGN] = { 0 };
+			if (offset > written) put(zeros, offset - written);
+		};
+		auto putArray = [&](const std::vector<double>& values) {
+			put(values.data(), values.size() * sizeof(double));
+		};
+
+		put(&header, sizeof(header));
+
+		padTo(header.bodyOffset);
+		putArray(data.x); putArray(data.y); putArray(data.z);
+		putArray(data.vx); putArray(data.vy); putArray(data.vz);
+		putArray(data.mass); putArray(data.radius);
+
+		padTo(header.particleOffset);
+		putArray(data.px); putArray(data.py); putArray(data.pz);
+		putArray(data.pvx); putArray(data.pvy); putArray(data.pvz);
+
+		padTo(header.trailOffset);
+		for (const CheckpointTrail& trail : data.trails) {
+			CheckpointTrailRecord record;
+			record.vertexCount = static_cast<uint32_t>(trail.vertices.size() / CHECKPOINT_TRAIL_VERTEX_FLOATS);
+			record.segmentsUsed = trail.segmentsUsed;
+			std::memcpy(record.last, trail.last, sizeof(record.last));
+			record.padding = 0;
+			put(&record, sizeof(record));
+			put(trail.vertices.data(), trail.vertices.size() * sizeof(float));
+		}
+
+		if (!out) return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	return !error;
+}
+
+// Writes checkpoints on a background thread. The caller hands over a captured
+// copy, so the simulation only pays for the copy, never for the disk.
+class CheckpointWriter {
+private:
+	std::thread worker;
+	std::atomic<bool> lastSucceeded{ true };
+
+public:
+	~CheckpointWriter() {
+		wait();
+	}
+
+	// Starts writing data to path, after the previous write has finished
+	void save(const std::string& path, CheckpointData&& data) {
+		wait();
+		worker = std::thread([this, path, captured = std::move(data)]() {
+			lastSucceeded.store(writeCheckpoint(path, captured));
+		});
+	}
+
+	void wait() {
+		if (worker.joinable()) worker.join();
+	}
+
+	bool succeeded() const {
+		return lastSucceeded.load();
+	}
+};
+
+// A checkpoint file mapped into memory. After open() the arrays point straight
+// into the mapping; restore() copies them into a BodySystem.
+class CheckpointView {
+private:
+	MappedFile file;
+	const CheckpointHeader* header = nullptr;
+	std::vector<const CheckpointTrailRecord*> trailRecords;
+
+	const double* bodyArray(size_t k) const {
+		return reinterpret_cast<const double*>(file.data() + header->bodyOffset) + k * header->bodyCount;
+	}
+
+	const double* particleArray(size_t k) const {
+		return reinterpret_cast<const double*>(file.data() + header->particleOffset) + k * header->particleCount;
+	}
+
+public:
+	// Maps the file and checks that every section lies inside it
+	bool open(const std::string& path) {
+		header = nullptr;
+		trailRecords.clear();
+		if (!file.open(path) || file.size() < sizeof(CheckpointHeader)) return false;
+
+		const CheckpointHeader* candidate = reinterpret_cast<const CheckpointHeader*>(file.data());
+		if (std::memcmp(candidate->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) return false;
+		if (candidate->version != CHECKPOINT_VERSION) return false;
+		if (candidate->byteOrder != CHECKPOINT_BYTE_ORDER) return false;
+		if (candidate->fileSize != file.size()) return false;
+		if (candidate->bodyCount > file.size() / sizeof(double)) return false;
+		if (candidate->particleCount > file.size() / sizeof(double)) return false;
+		// Offsets no larger than the file, so the section ends below cannot wrap
+		if (candidate->bodyOffset > file.size() || candidate->particleOffset > file.size()) return false;
+		if (candidate->trailOffset > file.size()) return false;
+
+		const uint64_t bodyEnd = candidate->bodyOffset + CHECKPOINT_BODY_ARRAYS * candidate->bodyCount * sizeof(double);
+		const uint64_t particleEnd = candidate->particleOffset + CHECKPOINT_PARTICLE_ARRAYS * candidate->particleCount * sizeof(double);
+		if (candidate->bodyOffset % CHECKPOINT_ALIGN != 0 || bodyEnd > candidate->particleOffset) return false;
+		if (candidate->particleOffset % CHECKPOINT_ALIGN != 0 || particleEnd > candidate->trailOffset) return false;
+
+		// Trail records have variable length, so walk them once
+		uint64_t offset = candidate->trailOffset;
+		for (uint64_t t = 0; t < candidate->trailCount; t++) {
+			if (offset + sizeof(CheckpointTrailRecord) > file.size()) return false;
+			const CheckpointTrailRecord* record = reinterpret_cast<const CheckpointTrailRecord*>(file.data() + offset);
+			offset += sizeof(CheckpointTrailRecord) + uint64_t(record->vertexCount) * CHECKPOINT_TRAIL_VERTEX_FLOATS * sizeof(float);
+			if (offset > file.size()) return false;
+			trailRecords.push_back(record);
+		}
+
+		header = candidate;
+		return true;
+	}
+
+	bool isOpen() const {
+		return header != nullptr;
+	}
+
+	double simTime() const { return header->simTime; }
+	size_t bodyCount() const { return static_cast<size_t>(header->bodyCount); }
+	size_t particleCount() const { return static_cast<size_t>(header->particleCount); }
+	size_t trailCount() const { return trailRecords.size(); }
+
+	const CheckpointTrailRecord& trailRecord(size_t t) const {
+		return *trailRecords[t];
+	}
+
+	// vertexCount * 6 floats following the record
+	const float* trailVertices(size_t t) const {
+		return reinterpret_cast<const float*>(trailRecords[t] + 1);
+	}
+
+	// Replace the state of bodies with the checkpoint
+	void restore(BodySystem& bodies) const {
+		const size_t n = bodyCount();
+		auto assign = [](std::vector<double>& target, const double* source, size_t count) {
+			target.assign(source, source + count);
+		};
+
+		assign(bodies.x, bodyArray(0), n); assign(bodies.y, bodyArray(1), n); assign(bodies.z, bodyArray(2), n);
+		assign(bodies.vx, bodyArray(3), n); assign(bodies.vy, bodyArray(4), n); assign(bodies.vz, bodyArray(5), n);
+		assign(bodies.mass, bodyArray(6), n); assign(bodies.radius, bodyArray(7), n);
+		bodies.ax.assign(n, 0.0); bodies.ay.assign(n, 0.0); bodies.az.assign(n, 0.0);
+
+		const size_t m = particleCount();
+		TestParticles& particles = bodies.particles;
+		assign(particles.x, particleArray(0), m); assign(particles.y, particleArray(1), m); assign(particles.z, particleArray(2), m);
+		assign(particles.vx, particleArray(3), m); assign(particles.vy, particleArray(4), m); assign(particles.vz, particleArray(5), m);
+		particles.ax.assign(m, 0.0); particles.ay.assign(m, 0.0); particles.az.assign(m, 0.0);
+
+		// Accelerations are not stored, the integrators recompute them
+		bodies.accelerationsValid = false;
+	}
+};
+
+#endif
@@ -0,0 +1,425 @@
+#ifndef COLLISIONDETECTOR_H
+#define COLLISIONDETECTOR_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <BodySystem.h>
+
+// What happens to two bodies that touch
+enum class CollisionResponse {
+	Log,    // only record the event, the bodies pass through each other
+	Merge,  // perfectly inelastic, the lighter body is absorbed
+	Bounce  // impulse along the contact normal, scaled by restitution
+};
+
+// Maps a command line name to a response, returns false for unknown names
+inline bool parseCollisionResponse(const std::string& name, CollisionResponse& out) {
+	if (name == "log") out = CollisionResponse::Log;
+	else if (name == "merge") out = CollisionResponse::Merge;
+	else if (name == "bounce") out = CollisionResponse::Bounce;
+	else return false;
+	return true;
+}
+
+enum class EncounterType {
+	CloseEncounter,  // came within encounterFactor * (ra + rb)
+	Collision        // came within ra + rb
+};
+
+struct CollisionEvent {
+	EncounterType type;
+
+	// Body indices, a < b. After a merge a is the survivor.
+	size_t a, b;
+
+	// Detector clock at the end of the step, in seconds
+	double time;
+
+	// Closest approach during the step in m, and the relative speed in m/s
+	double distance;
+	double relativeSpeed;
+
+	// The response changed the bodies
+	bool resolved;
+};
+
+// Finds close encounters and collisions between bodies with a radius, after
+// every integrator step. Each body is wrapped in a sphere covering its motion
+// over the step plus the encounter distance; the spheres go into a uniform
+// spatial hash, so only bodies in neighbouring cells are compared and a pass
+// costs O(N). Pairs are then tested along their straight-line relative motion
+// over the step, so fast bodies cannot step through each other.
+//
+// Merged bodies keep their index with zero mass and radius, and are moved
+// along with the body that absorbed them so they stay out of the way.
+class CollisionDetector {
+private:
+	static constexpr size_t NONE = SIZE_MAX;
+
+	// Candidates per parallel chunk of the pair search
+	static const size_t GRAIN = 512;
+
+	struct Contact {
+		size_t a, b;
+		double distance;
+		double relativeSpeed;
+		bool collision;
+	};
+
+	// Bodies taking part in this pass, and their swept spheres
+	std::vector<size_t> candidates;
+	std::vector<double> cx, cy, cz, reach;
+	std::vector<int64_t> cellX, cellY, cellZ;
+
+	// Spatial hash: candidate slots grouped by bucket, bucketStart has one extra entry
+	std::vector<uint32_t> bucketStart;
+	std::vector<uint32_t> bucketFill;
+	std::vector<uint32_t> bucketSlots;
+	std::vector<uint32_t> slotBucket;
+
+	std::vector<std::vector<Contact>> chunkContacts;
+	std::vector<Contact> contacts;
+
+	// Pairs within range at the end of the last pass, so a lasting
+	// encounter is reported once instead of on every step
+	std::vector<uint64_t> encounterPairs, collisionPairs;
+	std::vector<uint64_t> nextEncounterPairs, nextCollisionPairs;
+
+	// Per body, the body it was merged into, or NONE
+	std::vector<size_t> absorbedBy;
+	std::vector<size_t> absorbed;
+
+	static uint64_t pairKey(size_t a, size_t b) {
+		return (static_cast<uint64_t>(a) << 32) | static_cast<uint64_t>(b);
+	}
+
+	static bool contains(const std::vector<uint64_t>& sorted, uint64_t key) {
+		return std::binary_search(sorted.begin(), sorted.end(), key);
+	}
+
+	static uint32_t hashCell(int64_t x, int64_t y, int64_t z, uint32_t mask) {
+		uint64_t h = static_cast<uint64_t>(x) * 73856093ULL
+			^ static_cast<uint64_t>(y) * 19349663ULL
+			^ static_cast<uint64_t>(z) * 83492791ULL;
+		return static_cast<uint32_t>((h ^ (h >> 29)) & mask);
+	}
+
+	size_t rootOf(size_t i) const {
+		while (absorbedBy[i] != NONE) i = absorbedBy[i];
+		return i;
+	}
+
+	// Keep merged remnants on top of their survivor
+	void followSurvivors(BodySystem& bodies) {
+		absorbedBy.resize(bodies.size(), NONE);
+		for (size_t i : absorbed) {
+			size_t root = rootOf(i);
+			bodies.x[i] = bodies.x[root]; bodies.y[i] = bodies.y[root]; bodies.z[i] = bodies.z[root];
+			bodies.vx[i] = bodies.vx[root]; bodies.vy[i] = bodies.vy[root]; bodies.vz[i] = bodies.vz[root];
+		}
+	}
+
+	// Closest approach of bodies i and j over the last dt, assuming straight-line motion
+	bool testPair(const BodySystem& bodies, size_t i, size_t j, double dt, Contact& contact) const {
+		double dx = bodies.x[j] - bodies.x[i];
+		double dy = bodies.y[j] - bodies.y[i];
+		double dz = bodies.z[j] - bodies.z[i];
+		double dvx = bodies.vx[j] - bodies.vx[i];
+		double dvy = bodies.vy[j] - bodies.vy[i];
+		double dvz = bodies.vz[j] - bodies.vz[i];
+
+		double speedSq = dvx * dvx + dvy * dvy + dvz * dvz;
+		double t = 0.0;
+		if (speedSq > 0.0)
+			t = std::clamp(-(dx * dvx + dy * dvy + dz * dvz) / speedSq, -dt, 0.0);
+
+		double mx = dx + dvx * t, my = dy + dvy * t, mz = dz + dvz * t;
+		double distance = std::sqrt(mx * mx + my * my + mz * mz);
+		double touching = bodies.radius[i] + bodies.radius[j];
+		if (distance >= encounterFactor * touching) return false;
+
+		contact.a = i;
+		contact.b = j;
+		contact.distance = distance;
+		contact.relativeSpeed = std::sqrt(speedSq);
+		contact.collision = distance < touching;
+		return true;
+	}
+
+	// Every candidate pair of the slots [begin, end), appended in a fixed order
+	void searchPairs(const BodySystem& bodies, size_t begin, size_t end, double dt,
+		uint32_t mask, std::vector<Contact>& out) const {
+		Contact contact;
+		for (size_t k = begin; k < end; k++) {
+			const size_t i = candidates[k];
+
+			if (reach[k] < 0.0) {
+				// Large sphere, against every other candidate. Large pairs are taken once.
+				for (size_t m = 0; m < candidates.size(); m++) {
+					if (m == k || (reach[m] < 0.0 && m < k)) continue;
+					size_t j = candidates[m];
+					if (testPair(bodies, std::min(i, j), std::max(i, j), dt, contact)) out.push_back(contact);
+				}
+				continue;
+			}
+
+			for (int64_t ox = -1; ox <= 1; ox++) {
+				for (int64_t oy = -1; oy <= 1; oy++) {
+					for (int64_t oz = -1; oz <= 1; oz++) {
+						const int64_t gx = cellX[k] + ox, gy = cellY[k] + oy, gz = cellZ[k] + oz;
+						const uint32_t bucket = hashCell(gx, gy, gz, mask);
+						for (uint32_t s = bucketStart[bucket]; s < bucketStart[bucket + 1]; s++) {
+							const size_t m = bucketSlots[s];
+							// Other cells sharing the bucket are skipped, so each pair is seen once
+							if (m <= k || cellX[m] != gx || cellY[m] != gy || cellZ[m] != gz) continue;
+							if (testPair(bodies, i, candidates[m], dt, contact)) out.push_back(contact);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void merge(BodySystem& bodies, size_t& a, size_t& b) {
+		// The heavier body survives, the lower index on a tie
+		if (bodies.mass[b] > bodies.mass[a]) std::swap(a, b);
+
+		const double ma = bodies.mass[a], mb = bodies.mass[b];
+		const double m = ma + mb;
+		bodies.x[a] = (ma * bodies.x[a] + mb * bodies.x[b]) / m;
+		bodies.y[a] = (ma * bodies.y[a] + mb * bodies.y[b]) / m;
+		bodies.z[a] = (ma * bodies.z[a] + mb * bodies.z[b]) / m;
+		bodies.vx[a] = (ma * bodies.vx[a] + mb * bodies.vx[b]) / m;
+		bodies.vy[a] = (ma * bodies.vy[a] + mb * bodies.vy[b]) / m;
+		bodies.vz[a] = (ma * bodies.vz[a] + mb * bodies.vz[b]) / m;
+		bodies.mass[a] = m;
+
+		// Volume is conserved
+		const double ra = bodies.radius[a], rb = bodies.radius[b];
+		bodies.radius[a] = std::cbrt(ra * ra * ra + rb * rb * rb);
+
+		bodies.mass[b] = 0.0;
+		bodies.radius[b] = 0.0;
+		absorbedBy[b] = a;
+		absorbed.push_back(b);
+		followSurvivors(bodies);
+	}
+
+	// Rewind the pair to first contact, exchange the impulse there and move
+	// them on with the new velocities for the rest of the step. False when
+	// they are already moving apart.
+	bool bounce(BodySystem& bodies, size_t a, size_t b, double dt) {
+		double dx = bodies.x[b] - bodies.x[a];
+		double dy = bodies.y[b] - bodies.y[a];
+		double dz = bodies.z[b] - bodies.z[a];
+		double dvx = bodies.vx[b] - bodies.vx[a];
+		double dvy = bodies.vy[b] - bodies.vy[a];
+		double dvz = bodies.vz[b] - bodies.vz[a];
+		const double touching = bodies.radius[a] + bodies.radius[b];
+
+		// First root of |d + dv t| = touching in [-dt, 0]
+		double qa = dvx * dvx + dvy * dvy + dvz * dvz;
+		double qb = 2.0 * (dx * dvx + dy * dvy + dz * dvz);
+		double qc = dx * dx + dy * dy + dz * dz - touching * touching;
+		double t = 0.0;
+		if (qa > 0.0) {
+			double disc = std::max(0.0, qb * qb - 4.0 * qa * qc);
+			t = std::clamp((-qb - std::sqrt(disc)) / (2.0 * qa), -dt, 0.0);
+		}
+
+		double nx = dx + dvx * t, ny = dy + dvy * t, nz = dz + dvz * t;
+		double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+		if (length == 0.0) return false;
+		nx /= length; ny /= length; nz /= length;
+
+		double approach = dvx * nx + dvy * ny + dvz * nz;
+		if (approach >= 0.0) return false;
+
+		const double ma = bodies.mass[a], mb = bodies.mass[b];
+		const double impulse = -(1.0 + restitution) * approach / (1.0 / ma + 1.0 / mb);
+
+		// Back to the contact time, new velocities, then forward again
+		for (size_t i : { a, b }) {
+			bodies.x[i] += bodies.vx[i] * t;
+			bodies.y[i] += bodies.vy[i] * t;
+			bodies.z[i] += bodies.vz[i] * t;
+		}
+		bodies.vx[a] -= impulse / ma * nx; bodies.vy[a] -= impulse / ma * ny; bodies.vz[a] -= impulse / ma * nz;
+		bodies.vx[b] += impulse / mb * nx; bodies.vy[b] += impulse / mb * ny; bodies.vz[b] += impulse / mb * nz;
+		for (size_t i : { a, b }) {
+			bodies.x[i] -= bodies.vx[i] * t;
+			bodies.y[i] -= bodies.vy[i] * t;
+			bodies.z[i] -= bodies.vz[i] * t;
+		}
+		return true;
+	}
+
+public:
+	CollisionResponse response = CollisionResponse::Merge;
+
+	// Pairs closer than this many times the sum of their radii are close encounters
+	double encounterFactor = 3.0;
+
+	// Share of the approach speed kept by a bounce, 1 is elastic
+	double restitution = 1.0;
+
+	// Side of the hash cells in m, 0 sizes them to the largest body sphere.
+	// With a fixed size, bodies whose sphere does not fit are tested against all.
+	double cellSize = 0.0;
+
+	// Simulated seconds, advanced by every pass; set it to the start time of the run
+	double time = 0.0;
+
+	// Events since the caller last cleared them
+	std::vector<CollisionEvent> events;
+
+	unsigned long long encounterCount = 0;
+	unsigned long long collisionCount = 0;
+
+	CollisionDetector() {}
+
+	explicit CollisionDetector(CollisionResponse response) : response(response) {}
+
+	// Body index i was absorbed by another body
+	bool isAbsorbed(size_t i) const {
+		return i < absorbedBy.size() && absorbedBy[i] != NONE;
+	}
+
+	// Index i was filled with a new body, it no longer follows the one that absorbed its predecessor
+	void release(size_t i) {
+		if (!isAbsorbed(i)) return;
+		absorbedBy[i] = NONE;
+		absorbed.erase(std::remove(absorbed.begin(), absorbed.end(), i), absorbed.end());
+	}
+
+	// Check the step of length dt that just ended and apply the response
+	void process(BodySystem& bodies, double dt) {
+		time += dt;
+		followSurvivors(bodies);
+
+		candidates.clear();
+		for (size_t i = 0; i < bodies.size(); i++) {
+			if (bodies.radius[i] > 0.0 && bodies.mass[i] > 0.0) candidates.push_back(i);
+		}
+		const size_t count = candidates.size();
+
+		// Sphere around each body's path over the step, with room for encounters
+		cx.resize(count); cy.resize(count); cz.resize(count); reach.resize(count);
+		double largest = 0.0;
+		for (size_t k = 0; k < count; k++) {
+			const size_t i = candidates[k];
+			const double half = 0.5 * dt;
+			cx[k] = bodies.x[i] - bodies.vx[i] * half;
+			cy[k] = bodies.y[i] - bodies.vy[i] * half;
+			cz[k] = bodies.z[i] - bodies.vz[i] * half;
+			double speed = std::sqrt(bodies.vx[i] * bodies.vx[i] + bodies.vy[i] * bodies.vy[i] + bodies.vz[i] * bodies.vz[i]);
+			reach[k] = speed * half + encounterFactor * bodies.radius[i];
+			largest = std::max(largest, reach[k]);
+		}
+
+		// Two spheres that fit in a cell and overlap lie in neighbouring cells.
+		// Larger ones are marked with a negative reach and kept out of the hash.
+		const double cell = cellSize > 0.0 ? cellSize : std::max(2.0 * largest, 1.0);
+		const double inverseCell = 1.0 / cell;
+		cellX.resize(count); cellY.resize(count); cellZ.resize(count);
+		for (size_t k = 0; k < count; k++) {
+			if (2.0 * reach[k] > cell) reach[k] = -1.0;
+			cellX[k] = static_cast<int64_t>(std::floor(cx[k] * inverseCell));
+			cellY[k] = static_cast<int64_t>(std::floor(cy[k] * inverseCell));
+			cellZ[k] = static_cast<int64_t>(std::floor(cz[k] * inverseCell));
+		}
+
+		// Counting sort of the slots by bucket
+		uint32_t buckets = 1;
+		while (buckets < 2 * count) buckets <<= 1;
+		const uint32_t mask = buckets - 1;
+		bucketStart.assign(buckets + 1, 0);
+		slotBucket.resize(count);
+		for (size_t k = 0; k < count; k++) {
+			if (reach[k] < 0.0) continue;
+			slotBucket[k] = hashCell(cellX[k], cellY[k], cellZ[k], mask);
+			bucketStart[slotBucket[k] + 1]++;
+		}
+		for (uint32_t b = 0; b < buckets; b++) bucketStart[b + 1] += bucketStart[b];
+		bucketSlots.resize(bucketStart[buckets]);
+		bucketFill.assign(bucketStart.begin(), bucketStart.end() - 1);
+		for (size_t k = 0; k < count; k++) {
+			if (reach[k] < 0.0) continue;
+			bucketSlots[bucketFill[slotBucket[k]]++] = static_cast<uint32_t>(k);
+		}
+
+		// Pair search, chunk by chunk so the order never depends on the threads
+		const size_t chunks = (count + GRAIN - 1) / GRAIN;
+		chunkContacts.resize(chunks);
+		auto search = [&](size_t begin, size_t end) {
+			std::vector<Contact>& out = chunkContacts[begin / GRAIN];
+			out.clear();
+			searchPairs(bodies, begin, end, dt, mask, out);
+		};
+		if (bodies.pool)
+			bodies.pool->parallelFor(0, count, GRAIN, search);
+		else
+			for (size_t b = 0; b < count; b += GRAIN) search(b, std::min(count, b + GRAIN));
+
+		contacts.clear();
+		for (size_t c = 0; c < chunks; c++) {
+			contacts.insert(contacts.end(), chunkContacts[c].begin(), chunkContacts[c].end());
+		}
+
+		// Report new encounters and collisions, then respond in the same order
+		nextEncounterPairs.clear();
+		nextCollisionPairs.clear();
+		bool changed = false;
+		for (Contact& contact : contacts) {
+			size_t a = contact.a, b = contact.b;
+			const uint64_t key = pairKey(a, b);
+			nextEncounterPairs.push_back(key);
+			if (contact.collision) nextCollisionPairs.push_back(key);
+
+			const bool newEncounter = !contains(encounterPairs, key);
+			const bool newCollision = contact.collision && !contains(collisionPairs, key);
+
+			CollisionEvent event;
+			event.type = contact.collision ? EncounterType::Collision : EncounterType::CloseEncounter;
+			event.time = time;
+			event.distance = contact.distance;
+			event.relativeSpeed = contact.relativeSpeed;
+			event.resolved = false;
+
+			// Either body may have been absorbed earlier in this pass
+			if (bodies.mass[a] == 0.0 || bodies.mass[b] == 0.0) continue;
+
+			if (contact.collision && response == CollisionResponse::Merge) {
+				merge(bodies, a, b);
+				event.resolved = true;
+			}
+			else if (contact.collision && response == CollisionResponse::Bounce) {
+				event.resolved = bounce(bodies, a, b, dt);
+			}
+			changed = changed || event.resolved;
+
+			if (!event.resolved && !(contact.collision ? newCollision : newEncounter)) continue;
+
+			event.a = a;
+			event.b = b;
+			events.push_back(event);
+			if (contact.collision) collisionCount++; else encounterCount++;
+		}
+
+		std::sort(nextEncounterPairs.begin(), nextEncounterPairs.end());
+		std::sort(nextCollisionPairs.begin(), nextCollisionPairs.end());
+		encounterPairs.swap(nextEncounterPairs);
+		collisionPairs.swap(nextCollisionPairs);
+
+		if (changed) {
+			bodies.accelerationsValid = false;
+			bodies.potentialValid = false;
+		}
+	}
+};
+
+#endif
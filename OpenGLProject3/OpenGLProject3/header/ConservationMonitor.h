@@ -0,0 +1,153 @@
+#ifndef CONSERVATIONMONITOR_H
+#define CONSERVATIONMONITOR_H
+
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <BodySystem.h>
+#include <Units.h>
+
+// Energy, linear momentum and angular momentum of the massive bodies at one time
+struct ConservationSample {
+	double time = 0.0;
+	double energy = 0.0;
+	double px = 0.0, py = 0.0, pz = 0.0;
+	double lx = 0.0, ly = 0.0, lz = 0.0;
+
+	// Relative changes since the first sample
+	double energyDrift = 0.0;
+	double momentumDrift = 0.0;
+	double angularDrift = 0.0;
+
+	// The potential came from the integrator's own force pass
+	bool reusedPotential = false;
+};
+
+// Records the conserved quantities every interval of simulated time. The
+// potential energy is taken from the per-body potentials the force pass
+// stores on request, so a sample costs O(N) on top of the step instead of a
+// second O(N^2) sweep. Schemes whose last pass does not match the final
+// positions (drift-last schemes, block steps, Wisdom-Holman) get one extra
+// force pass per sample instead.
+class ConservationMonitor {
+private:
+	std::vector<ConservationSample> samples;
+	double nextSample = 0.0;
+
+	// Sum of m|v| at the first sample, the scale for the momentum drift
+	double momentumScale = 0.0;
+
+public:
+	// Simulated time between samples
+	Seconds interval = Days(30.0);
+
+	ConservationMonitor() {}
+
+	explicit ConservationMonitor(Seconds interval) : interval(interval) {}
+
+	bool due(double time) const {
+		return samples.empty() || time >= nextSample;
+	}
+
+	// Call before advancing to time until: when a sample falls due there, the
+	// force passes of that advance also store the potentials
+	void prepare(BodySystem& bodies, double until) const {
+		bodies.potentialRequested = due(until);
+	}
+
+	// Record a sample at time if one is due, returns whether it did
+	bool sample(BodySystem& bodies, double time) {
+		if (!due(time)) return false;
+
+		ConservationSample s;
+		s.time = time;
+		s.reusedPotential = bodies.hasPotential();
+		if (!s.reusedPotential) {
+			bodies.potentialRequested = true;
+			bodies.computeAccelerations();
+		}
+		bodies.potentialRequested = false;
+
+		double kinetic = 0.0;
+		double speedSum = 0.0;
+		for (size_t i = 0; i < bodies.size(); i++) {
+			const double m = bodies.mass[i];
+			const double vx = bodies.vx[i], vy = bodies.vy[i], vz = bodies.vz[i];
+			const double v2 = vx * vx + vy * vy + vz * vz;
+			kinetic += 0.5 * m * v2;
+			speedSum += m * std::sqrt(v2);
+
+			s.px += m * vx;
+			s.py += m * vy;
+			s.pz += m * vz;
+
+			s.lx += m * (bodies.y[i] * vz - bodies.z[i] * vy);
+			s.ly += m * (bodies.z[i] * vx - bodies.x[i] * vz);
+			s.lz += m * (bodies.x[i] * vy - bodies.y[i] * vx);
+		}
+		s.energy = kinetic + bodies.potentialEnergy();
+
+		if (samples.empty()) {
+			momentumScale = speedSum;
+		}
+		else {
+			const ConservationSample& first = samples.front();
+			s.energyDrift = std::abs((s.energy - first.energy) / first.energy);
+
+			double dpx = s.px - first.px, dpy = s.py - first.py, dpz = s.pz - first.pz;
+			if (momentumScale > 0.0) s.momentumDrift = std::sqrt(dpx * dpx + dpy * dpy + dpz * dpz) / momentumScale;
+
+			double dlx = s.lx - first.lx, dly = s.ly - first.ly, dlz = s.lz - first.lz;
+			double l0 = std::sqrt(first.lx * first.lx + first.ly * first.ly + first.lz * first.lz);
+			if (l0 > 0.0) s.angularDrift = std::sqrt(dlx * dlx + dly * dly + dlz * dlz) / l0;
+		}
+
+		samples.push_back(s);
+		nextSample = time + interval.value();
+		return true;
+	}
+
+	const std::vector<ConservationSample>& series() const {
+		return samples;
+	}
+
+	const ConservationSample& latest() const {
+		return samples.back();
+	}
+
+	double maxEnergyDrift() const {
+		double worst = 0.0;
+		for (const ConservationSample& s : samples) worst = std::max(worst, s.energyDrift);
+		return worst;
+	}
+
+	void clear() {
+		samples.clear();
+		nextSample = 0.0;
+	}
+
+	// Back to simulated time, e.g. after a seek: later samples are dropped and
+	// the next one falls due an interval after the last one kept
+	void rewind(double time) {
+		while (!samples.empty() && samples.back().time > time) samples.pop_back();
+		nextSample = samples.empty() ? 0.0 : samples.back().time + interval.value();
+	}
+
+	void writeCSV(std::ostream& out) const {
+		out << "time_days,energy,energy_drift,momentum_drift,angular_momentum_drift,reused_potential" << std::endl;
+		out << std::setprecision(17);
+		for (const ConservationSample& s : samples) {
+			out << Days(Seconds(s.time)).value() << ','
+				<< s.energy << ','
+				<< s.energyDrift << ','
+				<< s.momentumDrift << ','
+				<< s.angularDrift << ','
+				<< (s.reusedPotential ? 1 : 0) << std::endl;
+		}
+		out << std::setprecision(6);
+	}
+};
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <BodySystem.h>
+#include <GravityKernel.h>
+#include <ThreadPool.h>
+#include <Units.h>
+
+// Pull between body i and body j in members [begin, end), added to i's and
+// subtracted from j's accelerations. Takes the rows as restrict pointers: rows of
+// different bodies never overlap, and without that promise the compiler would
+// need more runtime alias checks than it emits and leave the loop scalar.
+inline void ensemblePairKernel(
+	const double* __restrict xi, const double* __restrict yi, const double* __restrict zi, const double* __restrict gmi,
+	const double* __restrict xj, const double* __restrict yj, const double* __restrict zj, const double* __restrict gmj,
+	double* __restrict axi, double* __restrict ayi, double* __restrict azi,
+	double* __restrict axj, double* __restrict ayj, double* __restrict azj,
+	size_t begin, size_t end) {
+	for (size_t m = begin; m < end; m++) {
+		double dx = xj[m] - xi[m];
+		double dy = yj[m] - yi[m];
+		double dz = zj[m] - zi[m];
+		double distSq = dx * dx + dy * dy + dz * dz;
+
+		// Same cutoff as the single-system kernels, as a select so the loop stays branch-free
+		bool apart = distSq >= GRAVITY_CUTOFF_SQ;
+		double safe = apart ? distSq : 1.0;
+		double inv = apart ? 1.0 / (safe * std::sqrt(safe)) : 0.0;
+
+		axi[m] += gmj[m] * dx * inv;
+		ayi[m] += gmj[m] * dy * inv;
+		azi[m] += gmj[m] * dz * inv;
+		axj[m] -= gmi[m] * dx * inv;
+		ayj[m] -= gmi[m] * dy * inv;
+		azj[m] -= gmi[m] * dz * inv;
+	}
+}
+
+// Many independent copies ("members") of one system, each built from its own
+// seed, integrated together with velocity Verlet. Stored body-major: the values
+// of body i for every member are contiguous at i * members + m, so every inner
+// loop runs over members with unit stride and vectorizes, while the pair loop
+// over bodies is shared by all of them. Members never interact; chunks of
+// members run in parallel, so each member's result is independent of the
+// thread count and of the ensemble size.
+class EnsembleSystem {
+private:
+	bool accelerationsValid = false;
+
+	size_t at(size_t i, size_t m) const {
+		return i * members + m;
+	}
+
+	template <class F>
+	void forMembers(F body) const {
+		if (pool)
+			pool->parallelFor(0, members, MEMBER_GRAIN, body);
+		else
+			for (size_t b = 0; b < members; b += MEMBER_GRAIN) body(b, std::min(members, b + MEMBER_GRAIN));
+	}
+
+	// Pairwise accelerations of members [begin, end), each pair visited once
+	void computeAccelerations(size_t begin, size_t end) {
+		const size_t n = bodyCount;
+		for (size_t i = 0; i < n; i++) {
+			std::fill(ax.begin() + at(i, begin), ax.begin() + at(i, end), 0.0);
+			std::fill(ay.begin() + at(i, begin), ay.begin() + at(i, end), 0.0);
+			std::fill(az.begin() + at(i, begin), az.begin() + at(i, end), 0.0);
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			for (size_t j = i + 1; j < n; j++) {
+				const size_t oi = at(i, 0), oj = at(j, 0);
+				ensemblePairKernel(x.data() + oi, y.data() + oi, z.data() + oi, gm.data() + oi,
+					x.data() + oj, y.data() + oj, z.data() + oj, gm.data() + oj,
+					ax.data() + oi, ay.data() + oi, az.data() + oi,
+					ax.data() + oj, ay.data() + oj, az.data() + oj, begin, end);
+			}
+		}
+	}
+
+	void kick(size_t begin, size_t end, double dt) {
+		for (size_t i = 0; i < bodyCount; i++) {
+			for (size_t k = at(i, begin); k < at(i, end); k++) {
+				vx[k] += ax[k] * dt;
+				vy[k] += ay[k] * dt;
+				vz[k] += az[k] * dt;
+			}
+		}
+	}
+
+	void drift(size_t begin, size_t end, double dt) {
+		for (size_t i = 0; i < bodyCount; i++) {
+			for (size_t k = at(i, begin); k < at(i, end); k++) {
+				x[k] += vx[k] * dt;
+				y[k] += vy[k] * dt;
+				z[k] += vz[k] * dt;
+			}
+		}
+	}
+
+public:
+	// Members per parallel chunk, a whole step runs on one chunk at a time
+	static const size_t MEMBER_GRAIN = 64;
+
+	size_t members = 0;
+	size_t bodyCount = 0;
+
+	// Body-major state, index body * members + member
+	std::vector<double> x, y, z;
+	std::vector<double> vx, vy, vz;
+	std::vector<double> ax, ay, az;
+	std::vector<double> mass, gm;
+
+	std::vector<unsigned int> seeds;
+
+	// Worker threads for the member chunks, serial when null
+	ThreadPool* pool = nullptr;
+
+	size_t size() const {
+		return members;
+	}
+
+	// One member per seed, each built by build() into a fresh BodySystem right
+	// after srand(seed). Every member must end up with the same number of bodies.
+	// Test particles are not carried over.
+	bool build(const std::vector<unsigned int>& memberSeeds, const std::function<void(BodySystem&)>& build) {
+		seeds = memberSeeds;
+		members = seeds.size();
+		bodyCount = 0;
+		accelerationsValid = false;
+
+		for (size_t m = 0; m < members; m++) {
+			srand(seeds[m]);
+			BodySystem bodies;
+			build(bodies);
+
+			if (m == 0) {
+				bodyCount = bodies.size();
+				for (std::vector<double>* v : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass, &gm }) {
+					v->assign(bodyCount * members, 0.0);
+				}
+			}
+			else if (bodies.size() != bodyCount) {
+				return false;
+			}
+
+			for (size_t i = 0; i < bodyCount; i++) {
+				const size_t k = at(i, m);
+				x[k] = bodies.x[i]; y[k] = bodies.y[i]; z[k] = bodies.z[i];
+				vx[k] = bodies.vx[i]; vy[k] = bodies.vy[i]; vz[k] = bodies.vz[i];
+				mass[k] = bodies.mass[i];
+				gm[k] = BodySystem::G * bodies.mass[i];
+			}
+		}
+		return true;
+	}
+
+	// Copy one member back out, e.g. to render or checkpoint it
+	void extract(size_t m, BodySystem& bodies) const {
+		bodies = BodySystem();
+		for (size_t i = 0; i < bodyCount; i++) {
+			const size_t k = at(i, m);
+			bodies.addBody(mass[k], x[k], y[k], z[k], vx[k], vy[k], vz[k]);
+		}
+	}
+
+	// One kick-drift-kick step of every member. Each chunk takes its whole step
+	// on its own, so its members stay in cache between the phases.
+	void step(double dt) {
+		const bool warm = accelerationsValid;
+		forMembers([&](size_t begin, size_t end) {
+			if (!warm) computeAccelerations(begin, end);
+			kick(begin, end, 0.5 * dt);
+			drift(begin, end, dt);
+			computeAccelerations(begin, end);
+			kick(begin, end, 0.5 * dt);
+		});
+		accelerationsValid = true;
+	}
+
+	// Advance by dt in equal substeps of at most maxSubstep, like Integrator::advance
+	void advance(Seconds dt, Seconds maxSubstep) {
+		if (dt <= Seconds(0.0) || members == 0) return;
+		int numSubsteps = static_cast<int>(std::ceil(dt / maxSubstep));
+		double substepDt = dt.value() / numSubsteps;
+		for (int s = 0; s < numSubsteps; s++) step(substepDt);
+	}
+
+	// Total energy of every member
+	void energies(std::vector<double>& out) const {
+		out.assign(members, 0.0);
+		forMembers([&](size_t begin, size_t end) {
+			for (size_t i = 0; i < bodyCount; i++) {
+				for (size_t m = begin; m < end; m++) {
+					const size_t k = at(i, m);
+					out[m] += 0.5 * mass[k] * (vx[k] * vx[k] + vy[k] * vy[k] + vz[k] * vz[k]);
+				}
+				for (size_t j = i + 1; j < bodyCount; j++) {
+					for (size_t m = begin; m < end; m++) {
+						const size_t a = at(i, m), b = at(j, m);
+						double dx = x[b] - x[a];
+						double dy = y[b] - y[a];
+						double dz = z[b] - z[a];
+						out[m] -= gm[a] * mass[b] / std::sqrt(dx * dx + dy * dy + dz * dz);
+					}
+				}
+			}
+		});
+	}
+
+	// Distance of body i from body c in member m
+	double distance(size_t i, size_t c, size_t m) const {
+		const size_t a = at(i, m), b = at(c, m);
+		double dx = x[a] - x[b];
+		double dy = y[a] - y[b];
+		double dz = z[a] - z[b];
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+};
+
+// Spread of one quantity over the ensemble
+struct EnsembleStatistic {
+	double mean = 0.0;
+	double deviation = 0.0;
+	double min = 0.0;
+	double max = 0.0;
+
+	static EnsembleStatistic of(const std::vector<double>& values) {
+		EnsembleStatistic s;
+		if (values.empty()) return s;
+		s.min = *std::min_element(values.begin(), values.end());
+		s.max = *std::max_element(values.begin(), values.end());
+		for (double v : values) s.mean += v;
+		s.mean /= static_cast<double>(values.size());
+		for (double v : values) s.deviation += (v - s.mean) * (v - s.mean);
+		s.deviation = std::sqrt(s.deviation / static_cast<double>(values.size()));
+		return s;
+	}
+};
+
+// Per-member results of a run: energy drift against the starting energies, and
+// every body's distance from the most massive one
+class EnsembleReport {
+public:
+	std::vector<unsigned int> seeds;
+	std::vector<double> energyDrift;
+
+	// distances[i][m], body i in member m
+	std::vector<std::vector<double>> distances;
+
+	size_t central = 0;
+
+	EnsembleReport(const EnsembleSystem& ensemble, const std::vector<double>& startEnergies) {
+		seeds = ensemble.seeds;
+		std::vector<double> energies;
+		ensemble.energies(energies);
+		energyDrift.resize(ensemble.members);
+		for (size_t m = 0; m < ensemble.members; m++) {
+			energyDrift[m] = std::abs((energies[m] - startEnergies[m]) / startEnergies[m]);
+		}
+
+		for (size_t i = 1; i < ensemble.bodyCount; i++) {
+			if (ensemble.mass[i * ensemble.members] > ensemble.mass[central * ensemble.members]) central = i;
+		}
+		distances.assign(ensemble.bodyCount, std::vector<double>(ensemble.members, 0.0));
+		for (size_t i = 0; i < ensemble.bodyCount; i++) {
+			for (size_t m = 0; m < ensemble.members; m++) distances[i][m] = ensemble.distance(i, central, m);
+		}
+	}
+
+	// Energy drift and distance spread per body, in AU
+	void writeSummary(std::ostream& out) const {
+		EnsembleStatistic drift = EnsembleStatistic::of(energyDrift);
+		out << "energy drift       mean " << std::scientific << std::setprecision(3) << drift.mean
+			<< ", max " << drift.max << std::defaultfloat << std::endl;
+
+		out << std::setw(6) << "body"
+			<< std::setw(14) << "mean(AU)"
+			<< std::setw(14) << "std(AU)"
+			<< std::setw(14) << "min(AU)"
+			<< std::setw(14) << "max(AU)" << std::endl;
+		for (size_t i = 0; i < distances.size(); i++) {
+			if (i == central) continue;
+			EnsembleStatistic d = EnsembleStatistic::of(distances[i]);
+			auto au = [](double meters) { return AstronomicalUnits(Meters(meters)).value(); };
+			out << std::setw(6) << i << std::fixed << std::setprecision(6)
+				<< std::setw(14) << au(d.mean)
+				<< std::setw(14) << au(d.deviation)
+				<< std::setw(14) << au(d.min)
+				<< std::setw(14) << au(d.max) << std::defaultfloat << std::endl;
+		}
+	}
+
+	// One row per member: seed, energy drift, then every body's distance in meters
+	void writeCSV(std::ostream& out) const {
+		out << "member,seed,energy_drift";
+		for (size_t i = 0; i < distances.size(); i++) out << ",distance_" << i;
+		out << '\n';
+		out << std::setprecision(17);
+		for (size_t m = 0; m < seeds.size(); m++) {
+			out << m << ',' << seeds[m] << ',' << energyDrift[m];
+			for (size_t i = 0; i < distances.size(); i++) out << ',' << distances[i][m];
+			out << '\n';
+		}
+	}
+};
+
+#endif
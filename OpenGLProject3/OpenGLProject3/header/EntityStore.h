@@ -0,0 +1,194 @@
+#ifndef ENTITYSTORE_H
+#define ENTITYSTORE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+// Entities are plain integer handles, everything known about one lives in
+// component arrays keyed by the handle. Each array keeps its components packed
+// in a dense vector, so a system walks only the components it needs and never
+// looks anything up by name.
+
+// Slot in the registry plus the generation of that slot when the entity was
+// made. A destroyed entity's slot is reused with the next generation, so an
+// old handle is recognised as dead instead of pointing at its successor.
+struct Entity {
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	uint32_t index = NONE;
+	uint32_t generation = 0;
+
+	bool valid() const {
+		return index != NONE;
+	}
+
+	bool operator==(const Entity& other) const {
+		return index == other.index && generation == other.generation;
+	}
+
+	bool operator!=(const Entity& other) const {
+		return !(*this == other);
+	}
+};
+
+class EntityRegistry {
+private:
+	std::vector<uint32_t> generations;
+	std::vector<uint32_t> freeSlots;
+	size_t living = 0;
+
+public:
+	Entity create() {
+		Entity entity;
+		if (!freeSlots.empty()) {
+			entity.index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			entity.index = static_cast<uint32_t>(generations.size());
+			generations.push_back(0);
+		}
+		entity.generation = generations[entity.index];
+		living++;
+		return entity;
+	}
+
+	// The caller removes the entity's components; the handle is dead from here on
+	bool destroy(Entity entity) {
+		if (!alive(entity)) return false;
+		generations[entity.index]++;
+		freeSlots.push_back(entity.index);
+		living--;
+		return true;
+	}
+
+	bool alive(Entity entity) const {
+		return entity.index < generations.size() && generations[entity.index] == entity.generation;
+	}
+
+	// Living entities
+	size_t size() const {
+		return living;
+	}
+
+	// Slots ever handed out, an upper bound for Entity::index
+	size_t capacity() const {
+		return generations.size();
+	}
+};
+
+// Components of one type, dense. sparse maps an entity slot to its component,
+// entities maps a component back to its owner. Removal moves the last component
+// into the gap, so components do not keep their position: hold the Entity, not
+// a pointer or dense index, across removals.
+template <class T>
+class ComponentArray {
+private:
+	static constexpr uint32_t ABSENT = UINT32_MAX;
+
+	std::vector<uint32_t> sparse;
+	std::vector<Entity> owners;
+	std::vector<T> values;
+
+	uint32_t slotOf(Entity entity) const {
+		if (entity.index >= sparse.size()) return ABSENT;
+		uint32_t k = sparse[entity.index];
+		return k != ABSENT && owners[k] == entity ? k : ABSENT;
+	}
+
+public:
+	// Replaces the component when the entity already has one
+	T& add(Entity entity, T value) {
+		uint32_t k = slotOf(entity);
+		if (k != ABSENT) {
+			values[k] = std::move(value);
+			return values[k];
+		}
+		if (entity.index >= sparse.size()) sparse.resize(entity.index + 1, ABSENT);
+		sparse[entity.index] = static_cast<uint32_t>(values.size());
+		owners.push_back(entity);
+		values.push_back(std::move(value));
+		return values.back();
+	}
+
+	bool remove(Entity entity) {
+		uint32_t k = slotOf(entity);
+		if (k == ABSENT) return false;
+		const uint32_t last = static_cast<uint32_t>(values.size() - 1);
+		if (k != last) {
+			values[k] = std::move(values[last]);
+			owners[k] = owners[last];
+			sparse[owners[k].index] = k;
+		}
+		values.pop_back();
+		owners.pop_back();
+		sparse[entity.index] = ABSENT;
+		return true;
+	}
+
+	bool has(Entity entity) const {
+		return slotOf(entity) != ABSENT;
+	}
+
+	// Null when the entity has no such component
+	T* find(Entity entity) {
+		uint32_t k = slotOf(entity);
+		return k == ABSENT ? nullptr : &values[k];
+	}
+
+	const T* find(Entity entity) const {
+		uint32_t k = slotOf(entity);
+		return k == ABSENT ? nullptr : &values[k];
+	}
+
+	// The entity must have the component
+	T& get(Entity entity) {
+		return values[sparse[entity.index]];
+	}
+
+	const T& get(Entity entity) const {
+		return values[sparse[entity.index]];
+	}
+
+	// Dense access, k in [0, size())
+	size_t size() const {
+		return values.size();
+	}
+
+	T& operator[](size_t k) {
+		return values[k];
+	}
+
+	const T& operator[](size_t k) const {
+		return values[k];
+	}
+
+	// The dense components, size() of them in a row
+	const T* data() const {
+		return values.data();
+	}
+
+	Entity entity(size_t k) const {
+		return owners[k];
+	}
+
+	typename std::vector<T>::iterator begin() { return values.begin(); }
+	typename std::vector<T>::iterator end() { return values.end(); }
+	typename std::vector<T>::const_iterator begin() const { return values.begin(); }
+	typename std::vector<T>::const_iterator end() const { return values.end(); }
+
+	void reserve(size_t count) {
+		owners.reserve(count);
+		values.reserve(count);
+	}
+
+	void clear() {
+		sparse.clear();
+		owners.clear();
+		values.clear();
+	}
+};
+
+#endif
@@ -0,0 +1,760 @@
+#ifndef GRAVITYKERNEL_H
+#define GRAVITYKERNEL_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <Units.h>
+#include <ForceModel.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GRAVITY_KERNEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang need the instruction set enabled per function, MSVC allows the intrinsics anywhere
+#if defined(GRAVITY_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define GRAVITY_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define GRAVITY_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define GRAVITY_TARGET_AVX2
+#define GRAVITY_TARGET_AVX512
+#endif
+
+// Direct-sum gravity kernels. Each computes the acceleration on the targets
+// [begin, end) from all n sources. gm holds G * mass per source so the product
+// is formed once per evaluation, not once per pair. The double-precision kernels
+// are templates on a force model policy (ForceModel.h), which decides the pairs
+// masked out (a body with itself always) and the softening, without a branch.
+// When pot is not null the gravitational potential -sum(gm / r) of every target
+// is stored as well, which costs little extra on top of the forces.
+enum class GravityKernel {
+	Scalar,
+	AVX2,   // 4 sources per iteration
+	AVX512  // 8 sources per iteration
+};
+
+inline const char* gravityKernelName(GravityKernel kernel) {
+	switch (kernel) {
+	case GravityKernel::AVX2: return "avx2";
+	case GravityKernel::AVX512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+inline bool parseGravityKernel(const std::string& name, GravityKernel& kernel) {
+	if (name == "scalar") kernel = GravityKernel::Scalar;
+	else if (name == "avx2") kernel = GravityKernel::AVX2;
+	else if (name == "avx512") kernel = GravityKernel::AVX512;
+	else return false;
+	return true;
+}
+
+// Precision of the pairwise terms in the direct sum and the test particle loop
+enum class ForcePrecision {
+	Double,
+	Mixed   // float displacements and 1/r^3, double positions and sums
+};
+
+inline const char* forcePrecisionName(ForcePrecision precision) {
+	return precision == ForcePrecision::Mixed ? "mixed" : "double";
+}
+
+// Float copy of the sources for the mixed-precision kernels. Positions are
+// taken relative to the centre of mass and measured in AU, and gm becomes
+// gm / AU^2, so the sums come out in m/s^2 without rescaling. In metres 1/r^3
+// would leave the float range beyond about 20 AU.
+struct MixedPrecisionSources {
+	static constexpr double LENGTH = Meters(AstronomicalUnits(1.0)).value();
+
+	std::vector<float> x, y, z, gm;
+	double originX = 0.0, originY = 0.0, originZ = 0.0;
+
+	size_t size() const {
+		return gm.size();
+	}
+
+	void prepare(const double* px, const double* py, const double* pz, const double* gmSI, size_t n) {
+		double total = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+		for (size_t j = 0; j < n; j++) {
+			total += gmSI[j];
+			cx += gmSI[j] * px[j]; cy += gmSI[j] * py[j]; cz += gmSI[j] * pz[j];
+		}
+		originX = total > 0.0 ? cx / total : 0.0;
+		originY = total > 0.0 ? cy / total : 0.0;
+		originZ = total > 0.0 ? cz / total : 0.0;
+
+		x.resize(n); y.resize(n); z.resize(n); gm.resize(n);
+		for (size_t j = 0; j < n; j++) {
+			x[j] = localX(px[j]);
+			y[j] = localY(py[j]);
+			z[j] = localZ(pz[j]);
+			gm[j] = static_cast<float>(gmSI[j] / (LENGTH * LENGTH));
+		}
+	}
+
+	// A position in the same frame
+	float localX(double px) const { return static_cast<float>((px - originX) / LENGTH); }
+	float localY(double py) const { return static_cast<float>((py - originY) / LENGTH); }
+	float localZ(double pz) const { return static_cast<float>((pz - originZ) / LENGTH); }
+
+	// The cutoff in the scaled units
+	static float cutoffSq() {
+		return static_cast<float>(GRAVITY_CUTOFF_SQ / (LENGTH * LENGTH));
+	}
+};
+
+// Sources [first, n) acting on one target, the scalar loop shared by all kernels
+template <class Model, bool WithPotential>
+inline void gravitySourcesScalar(const Model& model, const double* x, const double* y, const double* z, const double* gm,
+	size_t first, size_t n, double xi, double yi, double zi,
+	double& sumX, double& sumY, double& sumZ, double& sumPot) {
+	for (size_t j = first; j < n; j++) {
+		double dx = x[j] - xi;
+		double dy = y[j] - yi;
+		double dz = z[j] - zi;
+		double distSq = dx * dx + dy * dy + dz * dz;
+		if (distSq < model.cutoffSq) continue;
+		if constexpr (Model::SOFTENED) distSq += model.softeningSq;
+
+		double invDist = 1.0 / std::sqrt(distSq);
+		double s = gm[j] * invDist * invDist * invDist;
+		sumX += dx * s;
+		sumY += dy * s;
+		sumZ += dz * s;
+		if constexpr (WithPotential) sumPot -= gm[j] * invDist;
+	}
+}
+
+template <class Model, bool WithPotential>
+inline void gravityKernelScalarImpl(const Model& model, const double* x, const double* y, const double* z, const double* gm,
+	size_t n, size_t begin, size_t end, double* ax, double* ay, double* az, double* pot) {
+	for (size_t i = begin; i < end; i++) {
+		double sumX = 0.0, sumY = 0.0, sumZ = 0.0, sumPot = 0.0;
+		gravitySourcesScalar<Model, WithPotential>(model, x, y, z, gm, 0, n, x[i], y[i], z[i], sumX, sumY, sumZ, sumPot);
+
+		ax[i] = sumX;
+		ay[i] = sumY;
+		az[i] = sumZ;
+		if constexpr (WithPotential) pot[i] = sumPot;
+	}
+}
+
+// Reference path
+template <class Model = NewtonianForce>
+inline void gravityKernelScalar(const double* x, const double* y, const double* z, const double* gm,
+	size_t n, size_t begin, size_t end, double* ax, double* ay, double* az, double* pot = nullptr,
+	const Model& model = Model()) {
+	if (pot)
+		gravityKernelScalarImpl<Model, true>(model, x, y, z, gm, n, begin, end, ax, ay, az, pot);
+	else
+		gravityKernelScalarImpl<Model, false>(model, x, y, z, gm, n, begin, end, ax, ay, az, pot);
+}
+
+// SIMD iterations the mixed kernels sum in float before adding to the double
+// accumulators. Each lane only collects a few terms, so this keeps float
+// accuracy relative to the total while the widening stays off the hot path.
+const size_t MIXED_BLOCK = 8;
+
+// Mixed-precision counterpart of gravitySourcesScalar, the potential is in gm / (AU * r)
+template <bool WithPotential>
+inline void gravitySourcesMixed(const MixedPrecisionSources& sources, size_t first, size_t n,
+	float xi, float yi, float zi, double& sumX, double& sumY, double& sumZ, double& sumPot) {
+	const float cutoff = MixedPrecisionSources::cutoffSq();
+	for (size_t j = first; j < n; j++) {
+		float dx = sources.x[j] - xi;
+		float dy = sources.y[j] - yi;
+		float dz = sources.z[j] - zi;
+		float distSq = dx * dx + dy * dy + dz * dz;
+		if (distSq < cutoff) continue;
+
+		float invDist = 1.0f / std::sqrt(distSq);
+		float s = sources.gm[j] * invDist * invDist * invDist;
+		sumX += static_cast<double>(dx * s);
+		sumY += static_cast<double>(dy * s);
+		sumZ += static_cast<double>(dz * s);
+		if constexpr (WithPotential) sumPot -= static_cast<double>(sources.gm[j] * invDist);
+	}
+}
+
+// Mixed-precision kernels take their targets [begin, end) from the sources themselves
+template <bool WithPotential>
+inline void gravityKernelMixedScalarImpl(const MixedPrecisionSources& sources, size_t begin, size_t end,
+	double* ax, double* ay, double* az, double* pot) {
+	const size_t n = sources.size();
+	for (size_t i = begin; i < end; i++) {
+		double sumX = 0.0, sumY = 0.0, sumZ = 0.0, sumPot = 0.0;
+		gravitySourcesMixed<WithPotential>(sources, 0, n, sources.x[i], sources.y[i], sources.z[i], sumX, sumY, sumZ, sumPot);
+
+		ax[i] = sumX;
+		ay[i] = sumY;
+		az[i] = sumZ;
+		if constexpr (WithPotential) pot[i] = sumPot * MixedPrecisionSources::LENGTH;
+	}
+}
+
+inline void gravityKernelMixedScalar(const MixedPrecisionSources& sources, size_t begin, size_t end,
+	double* ax, double* ay, double* az, double* pot = nullptr) {
+	if (pot)
+		gravityKernelMixedScalarImpl<true>(sources, begin, end, ax, ay, az, pot);
+	else
+		gravityKernelMixedScalarImpl<false>(sources, begin, end, ax, ay, az, pot);
+}
+
+// Mixed-precision pull of all sources on count targets that are not sources,
+// e.g. test particles, given in the sources' frame (MixedPrecisionSources::localX).
+// The SIMD versions put targets in the lanes and broadcast the sources, which
+// suits a few sources and many targets, where the kernels above would leave
+// most lanes of their source loop empty.
+inline void particleKernelMixedScalar(const MixedPrecisionSources& sources, const float* tx, const float* ty, const float* tz,
+	size_t count, double* ax, double* ay, double* az) {
+	const size_t n = sources.size();
+	for (size_t i = 0; i < count; i++) {
+		double sumX = 0.0, sumY = 0.0, sumZ = 0.0, sumPot = 0.0;
+		gravitySourcesMixed<false>(sources, 0, n, tx[i], ty[i], tz[i], sumX, sumY, sumZ, sumPot);
+		ax[i] = sumX;
+		ay[i] = sumY;
+		az[i] = sumZ;
+	}
+}
+
+#ifdef GRAVITY_KERNEL_X86
+
+GRAVITY_TARGET_AVX2
+inline double horizontalSum(__m256d v) {
+	__m128d low = _mm256_castpd256_pd128(v);
+	__m128d high = _mm256_extractf128_pd(v, 1);
+	low = _mm_add_pd(low, high);
+	return _mm_cvtsd_f64(_mm_add_sd(low, _mm_unpackhi_pd(low, low)));
+}
+
+// 1/sqrt(d) from the single precision estimate (12 bits) refined by three
+// Newton steps, each roughly doubling the correct bits, to full double accuracy
+GRAVITY_TARGET_AVX2
+inline __m256d inverseSqrtAVX2(__m256d d) {
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d threeHalves = _mm256_set1_pd(1.5);
+
+	__m256d r = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(d)));
+	__m256d halfD = _mm256_mul_pd(half, d);
+	for (int k = 0; k < 3; k++) {
+		r = _mm256_mul_pd(r, _mm256_fnmadd_pd(halfD, _mm256_mul_pd(r, r), threeHalves));
+	}
+	return r;
+}
+
+template <class Model, bool WithPotential>
+GRAVITY_TARGET_AVX2
+inline void gravityKernelAVX2Impl(const Model& model, const double* x, const double* y, const double* z, const double* gm,
+	size_t n, size_t begin, size_t end, double* ax, double* ay, double* az, double* pot) {
+	const size_t n4 = n & ~static_cast<size_t>(3);
+	const __m256d cutoff = _mm256_set1_pd(model.cutoffSq);
+	const __m256d softeningSq = _mm256_set1_pd(model.softeningSq);
+
+	for (size_t i = begin; i < end; i++) {
+		const __m256d xi = _mm256_set1_pd(x[i]);
+		const __m256d yi = _mm256_set1_pd(y[i]);
+		const __m256d zi = _mm256_set1_pd(z[i]);
+		__m256d sumX = _mm256_setzero_pd();
+		__m256d sumY = _mm256_setzero_pd();
+		__m256d sumZ = _mm256_setzero_pd();
+		__m256d sumPot = _mm256_setzero_pd();
+
+		for (size_t j = 0; j < n4; j += 4) {
+			__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+			__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+			__m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), zi);
+			__m256d distSq = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+
+			__m256d mask = _mm256_cmp_pd(distSq, cutoff, _CMP_GE_OQ);
+			if constexpr (Model::SOFTENED) distSq = _mm256_add_pd(distSq, softeningSq);
+			__m256d invDist = inverseSqrtAVX2(distSq);
+			__m256d invDist3 = _mm256_mul_pd(invDist, _mm256_mul_pd(invDist, invDist));
+			__m256d gmj = _mm256_loadu_pd(gm + j);
+			__m256d s = _mm256_and_pd(mask, _mm256_mul_pd(gmj, invDist3));
+
+			sumX = _mm256_fmadd_pd(dx, s, sumX);
+			sumY = _mm256_fmadd_pd(dy, s, sumY);
+			sumZ = _mm256_fmadd_pd(dz, s, sumZ);
+			if constexpr (WithPotential) sumPot = _mm256_sub_pd(sumPot, _mm256_and_pd(mask, _mm256_mul_pd(gmj, invDist)));
+		}
+
+		double accX = horizontalSum(sumX);
+		double accY = horizontalSum(sumY);
+		double accZ = horizontalSum(sumZ);
+		double accPot = WithPotential ? horizontalSum(sumPot) : 0.0;
+
+		// Remaining sources
+		gravitySourcesScalar<Model, WithPotential>(model, x, y, z, gm, n4, n, x[i], y[i], z[i], accX, accY, accZ, accPot);
+
+		ax[i] = accX;
+		ay[i] = accY;
+		az[i] = accZ;
+		if constexpr (WithPotential) pot[i] = accPot;
+	}
+}
+
+template <class Model = NewtonianForce>
+inline void gravityKernelAVX2(const double* x, const double* y, const double* z, const double* gm,
+	size_t n, size_t begin, size_t end, double* ax, double* ay, double* az, double* pot = nullptr,
+	const Model& model = Model()) {
+	if (pot)
+		gravityKernelAVX2Impl<Model, true>(model, x, y, z, gm, n, begin, end, ax, ay, az, pot);
+	else
+		gravityKernelAVX2Impl<Model, false>(model, x, y, z, gm, n, begin, end, ax, ay, az, pot);
+}
+
+// Widen 8 floats and add them to two double accumulators
+GRAVITY_TARGET_AVX2
+inline void accumulateAVX2(__m256 v, __m256d& low, __m256d& high) {
+	low = _mm256_add_pd(low, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+	high = _mm256_add_pd(high, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+}
+
+// 8 sources per iteration. One Newton step takes the 12 bit estimate to float accuracy.
+template <bool WithPotential>
+GRAVITY_TARGET_AVX2
+inline void gravityKernelMixedAVX2Impl(const MixedPrecisionSources& sources, size_t begin, size_t end,
+	double* ax, double* ay, double* az, double* pot) {
+	const size_t n = sources.size();
+	const size_t n8 = n & ~static_cast<size_t>(7);
+	const float* x = sources.x.data();
+	const float* y = sources.y.data();
+	const float* z = sources.z.data();
+	const float* gm = sources.gm.data();
+	const __m256 cutoff = _mm256_set1_ps(MixedPrecisionSources::cutoffSq());
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+	for (size_t i = begin; i < end; i++) {
+		const __m256 xi = _mm256_set1_ps(x[i]);
+		const __m256 yi = _mm256_set1_ps(y[i]);
+		const __m256 zi = _mm256_set1_ps(z[i]);
+		__m256d sumX0 = _mm256_setzero_pd(), sumX1 = _mm256_setzero_pd();
+		__m256d sumY0 = _mm256_setzero_pd(), sumY1 = _mm256_setzero_pd();
+		__m256d sumZ0 = _mm256_setzero_pd(), sumZ1 = _mm256_setzero_pd();
+		__m256d sumPot0 = _mm256_setzero_pd(), sumPot1 = _mm256_setzero_pd();
+
+		for (size_t block = 0; block < n8; block += 8 * MIXED_BLOCK) {
+			const size_t blockEnd = std::min(n8, block + 8 * MIXED_BLOCK);
+			__m256 partX = _mm256_setzero_ps();
+			__m256 partY = _mm256_setzero_ps();
+			__m256 partZ = _mm256_setzero_ps();
+			__m256 partPot = _mm256_setzero_ps();
+
+			for (size_t j = block; j < blockEnd; j += 8) {
+				__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xi);
+				__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yi);
+				__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), zi);
+				__m256 distSq = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+
+				__m256 mask = _mm256_cmp_ps(distSq, cutoff, _CMP_GE_OQ);
+				__m256 invDist = _mm256_rsqrt_ps(distSq);
+				invDist = _mm256_mul_ps(invDist, _mm256_fnmadd_ps(_mm256_mul_ps(half, distSq), _mm256_mul_ps(invDist, invDist), threeHalves));
+				__m256 invDist3 = _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist));
+				__m256 gmj = _mm256_loadu_ps(gm + j);
+				__m256 s = _mm256_and_ps(mask, _mm256_mul_ps(gmj, invDist3));
+
+				partX = _mm256_fmadd_ps(dx, s, partX);
+				partY = _mm256_fmadd_ps(dy, s, partY);
+				partZ = _mm256_fmadd_ps(dz, s, partZ);
+				if constexpr (WithPotential) partPot = _mm256_add_ps(partPot, _mm256_and_ps(mask, _mm256_mul_ps(gmj, invDist)));
+			}
+
+			accumulateAVX2(partX, sumX0, sumX1);
+			accumulateAVX2(partY, sumY0, sumY1);
+			accumulateAVX2(partZ, sumZ0, sumZ1);
+			if constexpr (WithPotential) accumulateAVX2(partPot, sumPot0, sumPot1);
+		}
+
+		double accX = horizontalSum(_mm256_add_pd(sumX0, sumX1));
+		double accY = horizontalSum(_mm256_add_pd(sumY0, sumY1));
+		double accZ = horizontalSum(_mm256_add_pd(sumZ0, sumZ1));
+		double accPot = WithPotential ? -horizontalSum(_mm256_add_pd(sumPot0, sumPot1)) : 0.0;
+
+		// Remaining sources
+		gravitySourcesMixed<WithPotential>(sources, n8, n, x[i], y[i], z[i], accX, accY, accZ, accPot);
+
+		ax[i] = accX;
+		ay[i] = accY;
+		az[i] = accZ;
+		if constexpr (WithPotential) pot[i] = accPot * MixedPrecisionSources::LENGTH;
+	}
+}
+
+inline void gravityKernelMixedAVX2(const MixedPrecisionSources& sources, size_t begin, size_t end,
+	double* ax, double* ay, double* az, double* pot = nullptr) {
+	if (pot)
+		gravityKernelMixedAVX2Impl<true>(sources, begin, end, ax, ay, az, pot);
+	else
+		gravityKernelMixedAVX2Impl<false>(sources, begin, end, ax, ay, az, pot);
+}
+
+// 8 targets per iteration, every MIXED_BLOCK sources summed in float
+GRAVITY_TARGET_AVX2
+inline void particleKernelMixedAVX2(const MixedPrecisionSources& sources, const float* tx, const float* ty, const float* tz,
+	size_t count, double* ax, double* ay, double* az) {
+	const size_t n = sources.size();
+	const size_t count8 = count & ~static_cast<size_t>(7);
+	const __m256 cutoff = _mm256_set1_ps(MixedPrecisionSources::cutoffSq());
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+	for (size_t i = 0; i < count8; i += 8) {
+		const __m256 xi = _mm256_loadu_ps(tx + i);
+		const __m256 yi = _mm256_loadu_ps(ty + i);
+		const __m256 zi = _mm256_loadu_ps(tz + i);
+		__m256d sumX0 = _mm256_setzero_pd(), sumX1 = _mm256_setzero_pd();
+		__m256d sumY0 = _mm256_setzero_pd(), sumY1 = _mm256_setzero_pd();
+		__m256d sumZ0 = _mm256_setzero_pd(), sumZ1 = _mm256_setzero_pd();
+
+		for (size_t block = 0; block < n; block += MIXED_BLOCK) {
+			const size_t blockEnd = std::min(n, block + MIXED_BLOCK);
+			__m256 partX = _mm256_setzero_ps();
+			__m256 partY = _mm256_setzero_ps();
+			__m256 partZ = _mm256_setzero_ps();
+
+			for (size_t j = block; j < blockEnd; j++) {
+				__m256 dx = _mm256_sub_ps(_mm256_set1_ps(sources.x[j]), xi);
+				__m256 dy = _mm256_sub_ps(_mm256_set1_ps(sources.y[j]), yi);
+				__m256 dz = _mm256_sub_ps(_mm256_set1_ps(sources.z[j]), zi);
+				__m256 distSq = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+
+				__m256 mask = _mm256_cmp_ps(distSq, cutoff, _CMP_GE_OQ);
+				__m256 invDist = _mm256_rsqrt_ps(distSq);
+				invDist = _mm256_mul_ps(invDist, _mm256_fnmadd_ps(_mm256_mul_ps(half, distSq), _mm256_mul_ps(invDist, invDist), threeHalves));
+				__m256 invDist3 = _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist));
+				__m256 s = _mm256_and_ps(mask, _mm256_mul_ps(_mm256_set1_ps(sources.gm[j]), invDist3));
+
+				partX = _mm256_fmadd_ps(dx, s, partX);
+				partY = _mm256_fmadd_ps(dy, s, partY);
+				partZ = _mm256_fmadd_ps(dz, s, partZ);
+			}
+
+			accumulateAVX2(partX, sumX0, sumX1);
+			accumulateAVX2(partY, sumY0, sumY1);
+			accumulateAVX2(partZ, sumZ0, sumZ1);
+		}
+
+		_mm256_storeu_pd(ax + i, sumX0); _mm256_storeu_pd(ax + i + 4, sumX1);
+		_mm256_storeu_pd(ay + i, sumY0); _mm256_storeu_pd(ay + i + 4, sumY1);
+		_mm256_storeu_pd(az + i, sumZ0); _mm256_storeu_pd(az + i + 4, sumZ1);
+	}
+
+	// Remaining targets
+	particleKernelMixedScalar(sources, tx + count8, ty + count8, tz + count8, count - count8, ax + count8, ay + count8, az + count8);
+}
+
+// AVX-512 starts from a 14 bit estimate, so two Newton steps reach double accuracy
+GRAVITY_TARGET_AVX512
+inline __m512d inverseSqrtAVX512(__m512d d) {
+	const __m512d half = _mm512_set1_pd(0.5);
+	const __m512d threeHalves = _mm512_set1_pd(1.5);
+
+	__m512d r = _mm512_rsqrt14_pd(d);
+	__m512d halfD = _mm512_mul_pd(half, d);
+	for (int k = 0; k < 2; k++) {
+		r = _mm512_mul_pd(r, _mm512_fnmadd_pd(halfD, _mm512_mul_pd(r, r), threeHalves));
+	}
+	return r;
+}
+
+template <class Model, bool WithPotential>
+GRAVITY_TARGET_AVX512
+inline void gravityKernelAVX512Impl(const Model& model, const double* x, const double* y, const double* z, const double* gm,
+	size_t n, size_t begin, size_t end, double* ax, double* ay, double* az, double* pot) {
+	const size_t n8 = n & ~static_cast<size_t>(7);
+	const __m512d cutoff = _mm512_set1_pd(model.cutoffSq);
+	const __m512d softeningSq = _mm512_set1_pd(model.softeningSq);
+
+	for (size_t i = begin; i < end; i++) {
+		const __m512d xi = _mm512_set1_pd(x[i]);
+		const __m512d yi = _mm512_set1_pd(y[i]);
+		const __m512d zi = _mm512_set1_pd(z[i]);
+		__m512d sumX = _mm512_setzero_pd();
+		__m512d sumY = _mm512_setzero_pd();
+		__m512d sumZ = _mm512_setzero_pd();
+		__m512d sumPot = _mm512_setzero_pd();
+
+		for (size_t j = 0; j < n8; j += 8) {
+			__m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), xi);
+			__m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), yi);
+			__m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + j), zi);
+			__m512d distSq = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+
+			__mmask8 mask = _mm512_cmp_pd_mask(distSq, cutoff, _CMP_GE_OQ);
+			if constexpr (Model::SOFTENED) distSq = _mm512_add_pd(distSq, softeningSq);
+			__m512d invDist = inverseSqrtAVX512(distSq);
+			__m512d invDist3 = _mm512_mul_pd(invDist, _mm512_mul_pd(invDist, invDist));
+			__m512d gmj = _mm512_loadu_pd(gm + j);
+			__m512d s = _mm512_maskz_mul_pd(mask, gmj, invDist3);
+
+			sumX = _mm512_fmadd_pd(dx, s, sumX);
+			sumY = _mm512_fmadd_pd(dy, s, sumY);
+			sumZ = _mm512_fmadd_pd(dz, s, sumZ);
+			if constexpr (WithPotential) sumPot = _mm512_sub_pd(sumPot, _mm512_maskz_mul_pd(mask, gmj, invDist));
+		}
+
+		double accX = _mm512_reduce_add_pd(sumX);
+		double accY = _mm512_reduce_add_pd(sumY);
+		double accZ = _mm512_reduce_add_pd(sumZ);
+		double accPot = WithPotential ? _mm512_reduce_add_pd(sumPot) : 0.0;
+
+		// Remaining sources
+		gravitySourcesScalar<Model, WithPotential>(model, x, y, z, gm, n8, n, x[i], y[i], z[i], accX, accY, accZ, accPot);
+
+		ax[i] = accX;
+		ay[i] = accY;
+		az[i] = accZ;
+		if constexpr (WithPotential) pot[i] = accPot;
+	}
+}
+
+template <class Model = NewtonianForce>
+inline void gravityKernelAVX512(const double* x, const double* y, const double* z, const double* gm,
+	size_t n, size_t begin, size_t end, double* ax, double* ay, double* az, double* pot = nullptr,
+	const Model& model = Model()) {
+	if (pot)
+		gravityKernelAVX512Impl<Model, true>(model, x, y, z, gm, n, begin, end, ax, ay, az, pot);
+	else
+		gravityKernelAVX512Impl<Model, false>(model, x, y, z, gm, n, begin, end, ax, ay, az, pot);
+}
+
+GRAVITY_TARGET_AVX512
+inline void accumulateAVX512(__m512 v, __m512d& low, __m512d& high) {
+	low = _mm512_add_pd(low, _mm512_cvtps_pd(_mm512_castps512_ps256(v)));
+	high = _mm512_add_pd(high, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1))));
+}
+
+// 16 sources per iteration, one Newton step on the 14 bit estimate
+template <bool WithPotential>
+GRAVITY_TARGET_AVX512
+inline void gravityKernelMixedAVX512Impl(const MixedPrecisionSources& sources, size_t begin, size_t end,
+	double* ax, double* ay, double* az, double* pot) {
+	const size_t n = sources.size();
+	const size_t n16 = n & ~static_cast<size_t>(15);
+	const float* x = sources.x.data();
+	const float* y = sources.y.data();
+	const float* z = sources.z.data();
+	const float* gm = sources.gm.data();
+	const __m512 cutoff = _mm512_set1_ps(MixedPrecisionSources::cutoffSq());
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 threeHalves = _mm512_set1_ps(1.5f);
+
+	for (size_t i = begin; i < end; i++) {
+		const __m512 xi = _mm512_set1_ps(x[i]);
+		const __m512 yi = _mm512_set1_ps(y[i]);
+		const __m512 zi = _mm512_set1_ps(z[i]);
+		__m512d sumX0 = _mm512_setzero_pd(), sumX1 = _mm512_setzero_pd();
+		__m512d sumY0 = _mm512_setzero_pd(), sumY1 = _mm512_setzero_pd();
+		__m512d sumZ0 = _mm512_setzero_pd(), sumZ1 = _mm512_setzero_pd();
+		__m512d sumPot0 = _mm512_setzero_pd(), sumPot1 = _mm512_setzero_pd();
+
+		for (size_t block = 0; block < n16; block += 16 * MIXED_BLOCK) {
+			const size_t blockEnd = std::min(n16, block + 16 * MIXED_BLOCK);
+			__m512 partX = _mm512_setzero_ps();
+			__m512 partY = _mm512_setzero_ps();
+			__m512 partZ = _mm512_setzero_ps();
+			__m512 partPot = _mm512_setzero_ps();
+
+			for (size_t j = block; j < blockEnd; j += 16) {
+				__m512 dx = _mm512_sub_ps(_mm512_loadu_ps(x + j), xi);
+				__m512 dy = _mm512_sub_ps(_mm512_loadu_ps(y + j), yi);
+				__m512 dz = _mm512_sub_ps(_mm512_loadu_ps(z + j), zi);
+				__m512 distSq = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+
+				__mmask16 mask = _mm512_cmp_ps_mask(distSq, cutoff, _CMP_GE_OQ);
+				__m512 invDist = _mm512_rsqrt14_ps(distSq);
+				invDist = _mm512_mul_ps(invDist, _mm512_fnmadd_ps(_mm512_mul_ps(half, distSq), _mm512_mul_ps(invDist, invDist), threeHalves));
+				__m512 invDist3 = _mm512_mul_ps(invDist, _mm512_mul_ps(invDist, invDist));
+				__m512 gmj = _mm512_loadu_ps(gm + j);
+				__m512 s = _mm512_maskz_mul_ps(mask, gmj, invDist3);
+
+				partX = _mm512_fmadd_ps(dx, s, partX);
+				partY = _mm512_fmadd_ps(dy, s, partY);
+				partZ = _mm512_fmadd_ps(dz, s, partZ);
+				if constexpr (WithPotential) partPot = _mm512_add_ps(partPot, _mm512_maskz_mul_ps(mask, gmj, invDist));
+			}
+
+			accumulateAVX512(partX, sumX0, sumX1);
+			accumulateAVX512(partY, sumY0, sumY1);
+			accumulateAVX512(partZ, sumZ0, sumZ1);
+			if constexpr (WithPotential) accumulateAVX512(partPot, sumPot0, sumPot1);
+		}
+
+		double accX = _mm512_reduce_add_pd(_mm512_add_pd(sumX0, sumX1));
+		double accY = _mm512_reduce_add_pd(_mm512_add_pd(sumY0, sumY1));
+		double accZ = _mm512_reduce_add_pd(_mm512_add_pd(sumZ0, sumZ1));
+		double accPot = WithPotential ? -_mm512_reduce_add_pd(_mm512_add_pd(sumPot0, sumPot1)) : 0.0;
+
+		// Remaining sources
+		gravitySourcesMixed<WithPotential>(sources, n16, n, x[i], y[i], z[i], accX, accY, accZ, accPot);
+
+		ax[i] = accX;
+		ay[i] = accY;
+		az[i] = accZ;
+		if constexpr (WithPotential) pot[i] = accPot * MixedPrecisionSources::LENGTH;
+	}
+}
+
+inline void gravityKernelMixedAVX512(const MixedPrecisionSources& sources, size_t begin, size_t end,
+	double* ax, double* ay, double* az, double* pot = nullptr) {
+	if (pot)
+		gravityKernelMixedAVX512Impl<true>(sources, begin, end, ax, ay, az, pot);
+	else
+		gravityKernelMixedAVX512Impl<false>(sources, begin, end, ax, ay, az, pot);
+}
+
+// 16 targets per iteration, every MIXED_BLOCK sources summed in float
+GRAVITY_TARGET_AVX512
+inline void particleKernelMixedAVX512(const MixedPrecisionSources& sources, const float* tx, const float* ty, const float* tz,
+	size_t count, double* ax, double* ay, double* az) {
+	const size_t n = sources.size();
+	const size_t count16 = count & ~static_cast<size_t>(15);
+	const __m512 cutoff = _mm512_set1_ps(MixedPrecisionSources::cutoffSq());
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 threeHalves = _mm512_set1_ps(1.5f);
+
+	for (size_t i = 0; i < count16; i += 16) {
+		const __m512 xi = _mm512_loadu_ps(tx + i);
+		const __m512 yi = _mm512_loadu_ps(ty + i);
+		const __m512 zi = _mm512_loadu_ps(tz + i);
+		__m512d sumX0 = _mm512_setzero_pd(), sumX1 = _mm512_setzero_pd();
+		__m512d sumY0 = _mm512_setzero_pd(), sumY1 = _mm512_setzero_pd();
+		__m512d sumZ0 = _mm512_setzero_pd(), sumZ1 = _mm512_setzero_pd();
+
+		for (size_t block = 0; block < n; block += MIXED_BLOCK) {
+			const size_t blockEnd = std::min(n, block + MIXED_BLOCK);
+			__m512 partX = _mm512_setzero_ps();
+			__m512 partY = _mm512_setzero_ps();
+			__m512 partZ = _mm512_setzero_ps();
+
+			for (size_t j = block; j < blockEnd; j++) {
+				__m512 dx = _mm512_sub_ps(_mm512_set1_ps(sources.x[j]), xi);
+				__m512 dy = _mm512_sub_ps(_mm512_set1_ps(sources.y[j]), yi);
+				__m512 dz = _mm512_sub_ps(_mm512_set1_ps(sources.z[j]), zi);
+				__m512 distSq = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+
+				__mmask16 mask = _mm512_cmp_ps_mask(distSq, cutoff, _CMP_GE_OQ);
+				__m512 invDist = _mm512_rsqrt14_ps(distSq);
+				invDist = _mm512_mul_ps(invDist, _mm512_fnmadd_ps(_mm512_mul_ps(half, distSq), _mm512_mul_ps(invDist, invDist), threeHalves));
+				__m512 invDist3 = _mm512_mul_ps(invDist, _mm512_mul_ps(invDist, invDist));
+				__m512 s = _mm512_maskz_mul_ps(mask, _mm512_set1_ps(sources.gm[j]), invDist3);
+
+				partX = _mm512_fmadd_ps(dx, s, partX);
+				partY = _mm512_fmadd_ps(dy, s, partY);
+				partZ = _mm512_fmadd_ps(dz, s, partZ);
+			}
+
+			accumulateAVX512(partX, sumX0, sumX1);
+			accumulateAVX512(partY, sumY0, sumY1);
+			accumulateAVX512(partZ, sumZ0, sumZ1);
+		}
+
+		_mm512_storeu_pd(ax + i, sumX0); _mm512_storeu_pd(ax + i + 8, sumX1);
+		_mm512_storeu_pd(ay + i, sumY0); _mm512_storeu_pd(ay + i + 8, sumY1);
+		_mm512_storeu_pd(az + i, sumZ0); _mm512_storeu_pd(az + i + 8, sumZ1);
+	}
+
+	// Remaining targets
+	particleKernelMixedScalar(sources, tx + count16, ty + count16, tz + count16, count - count16, ax + count16, ay + count16, az + count16);
+}
+
+#endif
+
+// Best kernel the running CPU supports. Each kernel needs a superset of the
+// instructions of the ones before it in GravityKernel.
+inline GravityKernel detectGravityKernel() {
+#if defined(GRAVITY_KERNEL_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	if (maxLeaf < 7) return GravityKernel::Scalar;
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	if (!osxsave) return GravityKernel::Scalar;
+
+	// The OS has to save the wide registers on context switches
+	unsigned long long xcr0 = _xgetbv(0);
+	bool ymm = (xcr0 & 0x6) == 0x6;
+	bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	bool avx512f = (info[1] & (1 << 16)) != 0;
+
+	if (avx512f && zmm) return GravityKernel::AVX512;
+	if (avx2 && fma && ymm) return GravityKernel::AVX2;
+	return GravityKernel::Scalar;
+#elif defined(GRAVITY_KERNEL_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return GravityKernel::AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return GravityKernel::AVX2;
+	return GravityKernel::Scalar;
+#else
+	return GravityKernel::Scalar;
+#endif
+}
+
+// A kernel the running CPU can execute, anything above the detected one would fault
+inline bool gravityKernelSupported(GravityKernel kernel) {
+	return static_cast<int>(kernel) <= static_cast<int>(detectGravityKernel());
+}
+
+template <class Model = NewtonianForce>
+inline void runGravityKernel(GravityKernel kernel, const double* x, const double* y, const double* z, const double* gm,
+	size_t n, size_t begin, size_t end, double* ax, double* ay, double* az, double* pot = nullptr,
+	const Model& model = Model()) {
+#ifdef GRAVITY_KERNEL_X86
+	if (kernel == GravityKernel::AVX512) {
+		gravityKernelAVX512(x, y, z, gm, n, begin, end, ax, ay, az, pot, model);
+		return;
+	}
+	if (kernel == GravityKernel::AVX2) {
+		gravityKernelAVX2(x, y, z, gm, n, begin, end, ax, ay, az, pot, model);
+		return;
+	}
+#endif
+	gravityKernelScalar(x, y, z, gm, n, begin, end, ax, ay, az, pot, model);
+}
+
+// Mixed-precision direct sum on the targets [begin, end) of sources
+inline void runGravityKernelMixed(GravityKernel kernel, const MixedPrecisionSources& sources,
+	size_t begin, size_t end, double* ax, double* ay, double* az, double* pot = nullptr) {
+#ifdef GRAVITY_KERNEL_X86
+	if (kernel == GravityKernel::AVX512) {
+		gravityKernelMixedAVX512(sources, begin, end, ax, ay, az, pot);
+		return;
+	}
+	if (kernel == GravityKernel::AVX2) {
+		gravityKernelMixedAVX2(sources, begin, end, ax, ay, az, pot);
+		return;
+	}
+#endif
+	gravityKernelMixedScalar(sources, begin, end, ax, ay, az, pot);
+}
+
+// Mixed-precision pull of the sources on count targets that are not sources
+inline void runParticleKernelMixed(GravityKernel kernel, const MixedPrecisionSources& sources,
+	const float* tx, const float* ty, const float* tz, size_t count, double* ax, double* ay, double* az) {
+#ifdef GRAVITY_KERNEL_X86
+	if (kernel == GravityKernel::AVX512) {
+		particleKernelMixedAVX512(sources, tx, ty, tz, count, ax, ay, az);
+		return;
+	}
+	if (kernel == GravityKernel::AVX2) {
+		particleKernelMixedAVX2(sources, tx, ty, tz, count, ax, ay, az);
+		return;
+	}
+#endif
+	particleKernelMixedScalar(sources, tx, ty, tz, count, ax, ay, az);
+}
+
+#endif
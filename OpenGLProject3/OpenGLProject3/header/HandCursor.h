@@ -179,10 +179,10 @@ public:
 	void draw(float x, float y, float pixelRadius = 25.0f, glm::vec3 color = glm::vec3(1.0f, 0.0f, 0.0f)) {
 		circleShader->use();
 
-		glUniform2f(glGetUniformLocation(circleShader->ID, "position"), float(x), float(y));
-		glUniform2f(glGetUniformLocation(circleShader->ID, "screenSize"), 1280.0f, 720.0f);
-		glUniform3f(glGetUniformLocation(circleShader->ID, "color"), 1.0f, 0.0f, 0.0f);
-		glUniform1f(glGetUniformLocation(circleShader->ID, "radius"), 50.0f);
+		circleShader->setVec2(Uniform::Position, glm::vec2(x, y));
+		circleShader->setVec2(Uniform::ScreenSize, glm::vec2(1280.0f, 720.0f));
+		circleShader->setVec3(Uniform::Color, glm::vec3(1.0f, 0.0f, 0.0f));
+		circleShader->setFloat(Uniform::Radius, 50.0f);
 
 		glBindVertexArray(circleVAO);
 		glDrawArrays(GL_TRIANGLE_FAN, 0, vertexCount);
@@ -0,0 +1,166 @@
+#ifndef HISTORYCACHE_H
+#define HISTORYCACHE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <BodySystem.h>
+#include <Units.h>
+
+// Keyframes of the full body and particle state, one every interval of
+// simulated time, kept in a single pool allocated up front. The pool is a ring:
+// once the memory budget is used up the oldest keyframe makes room for the
+// newest. Seeking restores the last keyframe at or before the target and the
+// caller replays from there, so a jump never replays more than one interval.
+//
+// Keyframes are only recorded past the newest one, so after a rewind the
+// replayed run reuses the keyframes it reproduces instead of storing them again.
+class HistoryCache {
+private:
+	// Doubles per keyframe: 8 arrays per body, 6 per particle, same as a checkpoint
+	static const size_t BODY_ARRAYS = 8;
+	static const size_t PARTICLE_ARRAYS = 6;
+
+	std::vector<double> pool;
+	std::vector<double> times;
+	size_t bodyCount = 0;
+	size_t particleCount = 0;
+	size_t slotDoubles = 0;
+
+	// Ring of slots, oldest at first
+	size_t first = 0;
+	size_t count = 0;
+
+	// Furthest time any run reached, seeks beyond it are clamped
+	double furthest = 0.0;
+
+	size_t slot(size_t k) const {
+		return (first + k) % times.size();
+	}
+
+	// Size the pool for the system, dropping every keyframe
+	void allocate(const BodySystem& bodies) {
+		bodyCount = bodies.size();
+		particleCount = bodies.particles.size();
+		slotDoubles = BODY_ARRAYS * bodyCount + PARTICLE_ARRAYS * particleCount;
+		size_t slots = std::max<size_t>(2, memoryBudget / (std::max<size_t>(1, slotDoubles) * sizeof(double)));
+		times.assign(slots, 0.0);
+		pool.assign(slots * slotDoubles, 0.0);
+		first = 0;
+		count = 0;
+	}
+
+	void store(size_t s, const BodySystem& bodies, double simTime) {
+		double* out = pool.data() + s * slotDoubles;
+		auto put = [&](const std::vector<double>& values) {
+			out = std::copy(values.begin(), values.end(), out);
+		};
+		put(bodies.x); put(bodies.y); put(bodies.z);
+		put(bodies.vx); put(bodies.vy); put(bodies.vz);
+		put(bodies.mass); put(bodies.radius);
+
+		const TestParticles& particles = bodies.particles;
+		put(particles.x); put(particles.y); put(particles.z);
+		put(particles.vx); put(particles.vy); put(particles.vz);
+		times[s] = simTime;
+	}
+
+	void load(size_t s, BodySystem& bodies) const {
+		const double* in = pool.data() + s * slotDoubles;
+		auto get = [&](std::vector<double>& values, size_t n) {
+			values.assign(in, in + n);
+			in += n;
+		};
+		get(bodies.x, bodyCount); get(bodies.y, bodyCount); get(bodies.z, bodyCount);
+		get(bodies.vx, bodyCount); get(bodies.vy, bodyCount); get(bodies.vz, bodyCount);
+		get(bodies.mass, bodyCount); get(bodies.radius, bodyCount);
+
+		TestParticles& particles = bodies.particles;
+		get(particles.x, particleCount); get(particles.y, particleCount); get(particles.z, particleCount);
+		get(particles.vx, particleCount); get(particles.vy, particleCount); get(particles.vz, particleCount);
+
+		// Accelerations are not stored, the integrators recompute them
+		bodies.accelerationsValid = false;
+	}
+
+public:
+	// Simulated time between keyframes, the most a seek has to replay
+	Seconds interval = Days(30.0);
+
+	// Bytes the keyframe pool may take
+	size_t memoryBudget = size_t(256) << 20;
+
+	HistoryCache() {}
+
+	HistoryCache(Seconds interval, size_t memoryBudget) : interval(interval), memoryBudget(memoryBudget) {}
+
+	size_t size() const {
+		return count;
+	}
+
+	size_t capacity() const {
+		return times.size();
+	}
+
+	double oldestTime() const {
+		return times[slot(0)];
+	}
+
+	double newestTime() const {
+		return times[slot(count - 1)];
+	}
+
+	double furthestTime() const {
+		return furthest;
+	}
+
+	void clear() {
+		count = 0;
+		first = 0;
+	}
+
+	// Called after every tick. Stores a keyframe once a whole interval has
+	// passed since the newest one, returns whether it did.
+	bool record(const BodySystem& bodies, double simTime) {
+		if (bodies.size() != bodyCount || bodies.particles.size() != particleCount || times.empty())
+			allocate(bodies);
+		if (count == 0) furthest = simTime;
+		furthest = std::max(furthest, simTime);
+
+		if (count > 0 && simTime < newestTime() + interval.value()) return false;
+
+		if (count == times.size()) {
+			first = (first + 1) % times.size();
+			count--;
+		}
+		store(slot(count), bodies, simTime);
+		count++;
+		return true;
+	}
+
+	// Target a seek can actually reach, between the oldest keyframe and the furthest time run
+	double clampTime(double time) const {
+		if (count == 0) return time;
+		return std::clamp(time, oldestTime(), furthest);
+	}
+
+	// Load the last keyframe at or before time into bodies. Returns its time
+	// through keyframeTime, or false when there is none.
+	bool restore(double time, BodySystem& bodies, double& keyframeTime) const {
+		if (count == 0 || time < oldestTime()) return false;
+
+		// Keyframe times increase around the ring, binary search on the logical index
+		size_t lo = 0, hi = count;
+		while (hi - lo > 1) {
+			size_t mid = (lo + hi) / 2;
+			if (times[slot(mid)] <= time) lo = mid;
+			else hi = mid;
+		}
+
+		load(slot(lo), bodies);
+		keyframeTime = times[slot(lo)];
+		return true;
+	}
+};
+
+#endif
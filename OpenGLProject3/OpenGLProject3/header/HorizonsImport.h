@@ -0,0 +1,210 @@
+#ifndef HORIZONSIMPORT_H
+#define HORIZONSIMPORT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <ChebyshevTable.h>
+#include <Units.h>
+
+// Reader for state vector tables exported by JPL Horizons (ephemeris type
+// VECTORS), one target per file. Both layouts are understood, between the
+// $$SOE and $$EOE markers:
+//
+//   2460000.500000000 = A.D. 2023-Feb-25 00:00:00.0000 TDB
+//    X = 1.234567890123456E+08 Y =-2.345678901234567E+07 Z = 3.456789012345678E+03
+//    VX= 1.234567890123456E+01 VY= 2.345678901234567E+01 VZ=-3.456789012345678E-01
+//
+// and with CSV_FORMAT=YES
+//
+//   2460000.500000000, A.D. 2023-Feb-25 00:00:00.0000, 1.23E+08, -2.34E+07, 3.45E+03, 12.3, 23.4, -0.34,
+//
+// Extra quantities (LT, RG, RR) are ignored. The target and centre names come
+// from the "Target body name:" and "Center body name:" header lines, the units
+// from "Output units" (KM-S, KM-D or AU-D). Samples are converted to SI.
+
+// Name in a Horizons header line such as "Target body name: Mars (499)   {source: mar097}"
+inline std::string horizonsBodyName(const std::string& line) {
+	size_t colon = line.find(':');
+	if (colon == std::string::npos) return std::string();
+	std::string rest = line.substr(colon + 1);
+	size_t end = rest.find_first_of("({");
+	if (end != std::string::npos) rest = rest.substr(0, end);
+	size_t begin = rest.find_first_not_of(" \t");
+	size_t last = rest.find_last_not_of(" \t\r");
+	return begin == std::string::npos ? std::string() : rest.substr(begin, last - begin + 1);
+}
+
+inline bool readHorizonsVectors(std::istream& in, EphemerisSamples& samples, std::string& error) {
+	double lengthScale = 1000.0;    // km
+	double timeScale = 1.0;         // per second
+	bool inTable = false;
+	bool sawTable = false;
+
+	// Sample being assembled in the default layout
+	double julianDate = 0.0;
+	double state[6] = { 0.0 };
+	int found = 0;
+	bool open = false;
+
+	auto finish = [&]() {
+		if (!open) return true;
+		open = false;
+		if (found != 0x3f) {
+			error = "incomplete state at JD " + std::to_string(julianDate);
+			return false;
+		}
+		const double t = julianDateToSeconds(julianDate);
+		if (!samples.t.empty() && t <= samples.t.back()) {
+			error = "times do not increase at JD " + std::to_string(julianDate);
+			return false;
+		}
+		const double velocityScale = lengthScale / timeScale;
+		samples.t.push_back(t);
+		samples.x.push_back(state[0] * lengthScale);
+		samples.y.push_back(state[1] * lengthScale);
+		samples.z.push_back(state[2] * lengthScale);
+		samples.vx.push_back(state[3] * velocityScale);
+		samples.vy.push_back(state[4] * velocityScale);
+		samples.vz.push_back(state[5] * velocityScale);
+		return true;
+	};
+
+	std::string line;
+	while (std::getline(in, line)) {
+		if (!inTable) {
+			if (line.rfind("$$SOE", 0) == 0) {
+				inTable = true;
+				sawTable = true;
+			}
+			else if (line.find("Target body name") != std::string::npos) {
+				samples.name = horizonsBodyName(line);
+			}
+			else if (line.find("Center body name") != std::string::npos) {
+				samples.center = horizonsBodyName(line);
+			}
+			else if (line.find("Output units") != std::string::npos) {
+				if (line.find("AU-D") != std::string::npos) {
+					lengthScale = Meters(AstronomicalUnits(1.0)).value();
+					timeScale = Seconds(Days(1.0)).value();
+				}
+				else if (line.find("KM-D") != std::string::npos) {
+					timeScale = Seconds(Days(1.0)).value();
+				}
+			}
+			continue;
+		}
+
+		if (line.rfind("$$EOE", 0) == 0) {
+			if (!finish()) return false;
+			inTable = false;
+			continue;
+		}
+
+		// CSV layout, one sample per line: JD, calendar date, X, Y, Z, VX, VY, VZ, ...
+		if (line.find(',') != std::string::npos) {
+			std::vector<std::string> fields;
+			std::stringstream stream(line);
+			std::string field;
+			while (std::getline(stream, field, ',')) fields.push_back(field);
+			if (fields.size() < 8) {
+				error = "short CSV line: " + line;
+				return false;
+			}
+			julianDate = std::strtod(fields[0].c_str(), nullptr);
+			for (int k = 0; k < 6; k++) state[k] = std::strtod(fields[2 + k].c_str(), nullptr);
+			found = 0x3f;
+			open = true;
+			if (!finish()) return false;
+			continue;
+		}
+
+		// Default layout: a date line, then key = value pairs over several lines
+		std::string spaced;
+		for (char c : line) {
+			if (c == '=') spaced += " = ";
+			else spaced += c;
+		}
+		std::stringstream tokens(spaced);
+		std::vector<std::string> words;
+		std::string word;
+		while (tokens >> word) words.push_back(word);
+		if (words.empty()) continue;
+
+		char* end = nullptr;
+		double value = std::strtod(words[0].c_str(), &end);
+		if (end != words[0].c_str() && *end == '\0') {
+			if (!finish()) return false;
+			julianDate = value;
+			found = 0;
+			open = true;
+			continue;
+		}
+
+		static const char* keys[6] = { "X", "Y", "Z", "VX", "VY", "VZ" };
+		for (size_t w = 0; w + 2 < words.size(); w++) {
+			if (words[w + 1] != "=") continue;
+			for (int k = 0; k < 6; k++) {
+				if (words[w] == keys[k]) {
+					state[k] = std::strtod(words[w + 2].c_str(), nullptr);
+					found |= 1 << k;
+				}
+			}
+		}
+	}
+
+	if (!sawTable) {
+		error = "no $$SOE table";
+		return false;
+	}
+	if (samples.name.empty()) {
+		error = "no target body name";
+		return false;
+	}
+	return true;
+}
+
+inline bool readHorizonsFile(const std::string& path, EphemerisSamples& samples, std::string& error) {
+	std::ifstream in(path);
+	if (!in) {
+		error = "cannot read " + path;
+		return false;
+	}
+	samples = EphemerisSamples();
+	if (!readHorizonsVectors(in, samples, error)) {
+		error = path + ": " + error;
+		return false;
+	}
+	return true;
+}
+
+// Read every file, fit each body and write the table. All files must share
+// one centre body. Prints nothing; the fits are returned for reporting.
+inline bool importHorizons(const std::vector<std::string>& paths, const std::string& outPath,
+	Seconds segmentLength, size_t coefficientCount, std::vector<ChebyshevFit>& fits, std::string& error) {
+	fits.clear();
+	std::string center;
+	for (const std::string& path : paths) {
+		EphemerisSamples samples;
+		if (!readHorizonsFile(path, samples, error)) return false;
+		if (fits.empty()) center = samples.center;
+		else if (samples.center != center) {
+			error = path + ": centre " + samples.center + " differs from " + center;
+			return false;
+		}
+
+		ChebyshevFit fit;
+		if (!fitChebyshev(samples, segmentLength.value(), coefficientCount, fit, error)) return false;
+		fits.push_back(std::move(fit));
+	}
+
+	if (!writeChebyshevTable(outPath, center, fits)) {
+		error = "cannot write " + outPath;
+		return false;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <BodySystem.h>
+#include <CollisionDetector.h>
+#include <Units.h>
+#include <cmath>
+
+enum class IntegratorType {
+	SemiImplicitEuler,
+	Leapfrog,        // drift-kick-drift
+	VelocityVerlet,  // kick-drift-kick
+	Yoshida4,        // 4th order composition, same coefficients as Forest-Ruth
+	BlockTimestep,   // per-body power-of-two steps, see BlockTimestep.h
+	WisdomHolman     // Kepler drift around the dominant body, see WisdomHolman.h
+};
+
+// Advances a BodySystem in time. Subclasses only implement one fixed step,
+// advance() splits a frame's dt into substeps of at most maxSubstep.
+// Inside a step everything is in SI, so step() takes plain seconds.
+class Integrator {
+public:
+	Seconds maxSubstep = Days(1.0);
+
+	// Checked after every substep when set
+	CollisionDetector* collisions = nullptr;
+
+	virtual ~Integrator() {}
+
+	virtual const char* name() const = 0;
+
+	// Force evaluations per step once warmed up, used to compare schemes
+	virtual int evaluationsPerStep() const = 0;
+
+	virtual void step(BodySystem& bodies, double dt) = 0;
+
+	void advance(BodySystem& bodies, Seconds dt) {
+		if (dt <= Seconds(0.0) || bodies.size() == 0) return;
+
+		int numSubsteps = static_cast<int>(std::ceil(dt / maxSubstep));
+		double substepDt = dt.value() / numSubsteps;
+
+		for (int i = 0; i < numSubsteps; i++) {
+			step(bodies, substepDt);
+			if (collisions) collisions->process(bodies, substepDt);
+		}
+	}
+};
+
+// First order, the scheme the project started with
+class SemiImplicitEulerIntegrator : public Integrator {
+public:
+	const char* name() const override { return "euler"; }
+	int evaluationsPerStep() const override { return 1; }
+
+	void step(BodySystem& bodies, double dt) override {
+		bodies.computeAccelerations();
+		bodies.kick(dt);
+		bodies.drift(dt);
+	}
+};
+
+// Second order drift-kick-drift leapfrog
+class LeapfrogIntegrator : public Integrator {
+public:
+	const char* name() const override { return "leapfrog"; }
+	int evaluationsPerStep() const override { return 1; }
+
+	void step(BodySystem& bodies, double dt) override {
+		bodies.drift(0.5 * dt);
+		bodies.computeAccelerations();
+		bodies.kick(dt);
+		bodies.drift(0.5 * dt);
+	}
+};
+
+// Second order kick-drift-kick. The closing accelerations are reused
+// as the opening ones of the next step, so it costs one evaluation per step.
+class VelocityVerletIntegrator : public Integrator {
+public:
+	const char* name() const override { return "verlet"; }
+	int evaluationsPerStep() const override { return 1; }
+
+	void step(BodySystem& bodies, double dt) override {
+		if (!bodies.accelerationsValid)
+			bodies.computeAccelerations();
+
+		bodies.kick(0.5 * dt);
+		bodies.drift(dt);
+		bodies.computeAccelerations();
+		bodies.kick(0.5 * dt);
+	}
+};
+
+// Yoshida's 4th order symmetric composition of three leapfrog steps
+class Yoshida4Integrator : public Integrator {
+private:
+	const double w1 = 1.0 / (2.0 - std::cbrt(2.0));
+	const double w0 = -std::cbrt(2.0) * w1;
+
+	const double c1 = 0.5 * w1;
+	const double c2 = 0.5 * (w0 + w1);
+	const double d1 = w1;
+	const double d2 = w0;
+
+public:
+	const char* name() const override { return "yoshida4"; }
+	int evaluationsPerStep() const override { return 3; }
+
+	void step(BodySystem& bodies, double dt) override {
+		bodies.drift(c1 * dt);
+		bodies.computeAccelerations();
+		bodies.kick(d1 * dt);
+		bodies.drift(c2 * dt);
+		bodies.computeAccelerations();
+		bodies.kick(d2 * dt);
+		bodies.drift(c2 * dt);
+		bodies.computeAccelerations();
+		bodies.kick(d1 * dt);
+		bodies.drift(c1 * dt);
+	}
+};
+
+#endif
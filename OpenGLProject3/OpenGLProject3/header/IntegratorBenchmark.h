@@ -0,0 +1,146 @@
+#ifndef INTEGRATORBENCHMARK_H
+#define INTEGRATORBENCHMARK_H
+
+#include <BodySystem.h>
+#include <IntegratorFactory.h>
+#include <SolarSystem.h>
+#include <KeplerEphemeris.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+// Run one integrator for the given number of years and print a result row.
+// Evaluations are counted per body and reported as full-system equivalents,
+// so partial evaluations of the block scheme compare fairly.
+inline void benchmarkIntegratorRun(std::ostream& out, Integrator& integrator, const std::string& setting,
+	Seconds dt, Years years, unsigned int seed) {
+	srand(seed);
+	BodySystem bodies;
+	buildSolarSystem(bodies);
+
+	long long steps = static_cast<long long>(std::ceil(years / dt));
+
+	double e0 = bodies.totalEnergy();
+	double maxError = 0.0;
+
+	// Only the integration is timed, not the energy bookkeeping
+	std::chrono::steady_clock::duration elapsed(0);
+	for (long long s = 0; s < steps; s++) {
+		auto start = std::chrono::steady_clock::now();
+		integrator.step(bodies, dt.value());
+		elapsed += std::chrono::steady_clock::now() - start;
+
+		double error = std::abs((bodies.totalEnergy() - e0) / e0);
+		if (error > maxError) maxError = error;
+	}
+
+	double simulatedYears = Years(dt * static_cast<double>(steps)).value();
+	double evalsPerYear = bodies.bodyEvaluations / static_cast<double>(bodies.size()) / simulatedYears;
+	double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+
+	out << std::left << std::setw(10) << integrator.name()
+		<< std::right << std::setw(14) << setting
+		<< std::setw(14) << std::fixed << std::setprecision(0) << evalsPerYear
+		<< std::setw(16) << std::scientific << std::setprecision(3) << maxError
+		<< std::setw(12) << std::fixed << std::setprecision(2) << ms
+		<< std::defaultfloat << std::endl;
+}
+
+// Energy error versus force evaluations per simulated year for every integrator
+// over a range of substep sizes, all starting from the same seeded solar system.
+// The block scheme picks its own steps, so it is swept over its accuracy parameter.
+inline void runIntegratorBenchmark(std::ostream& out, double years = 20.0, unsigned int seed = 42) {
+	const double substepDays[] = { 0.5, 1.0, 2.0, 4.0, 8.0, 16.0, 32.0, 64.0 };
+	const double etas[] = { 0.0125, 0.025, 0.05, 0.1, 0.2 };
+	const IntegratorType types[] = {
+		IntegratorType::SemiImplicitEuler,
+		IntegratorType::Leapfrog,
+		IntegratorType::VelocityVerlet,
+		IntegratorType::Yoshida4,
+		IntegratorType::WisdomHolman
+	};
+
+	out << std::left << std::setw(10) << "scheme"
+		<< std::right << std::setw(14) << "setting"
+		<< std::setw(14) << "evals/year"
+		<< std::setw(16) << "max |dE/E|"
+		<< std::setw(12) << "time(ms)" << std::endl;
+
+	for (IntegratorType type : types) {
+		for (double days : substepDays) {
+			std::unique_ptr<Integrator> integrator = makeIntegrator(type);
+			std::ostringstream setting;
+			setting << "dt=" << days << "d";
+			benchmarkIntegratorRun(out, *integrator, setting.str(), Days(days), Years(years), seed);
+		}
+	}
+
+	for (double eta : etas) {
+		BlockTimestepIntegrator integrator;
+		integrator.eta = eta;
+		std::ostringstream setting;
+		setting << "eta=" << eta;
+		benchmarkIntegratorRun(out, integrator, setting.str(), integrator.maxSubstep, Years(years), seed);
+	}
+}
+
+// Cost of reaching a date on rails versus integrating to it, for the solar
+// system plus a belt of test particles. The rails column should stay flat
+// however far ahead the date is. Earth's offset is how far the catalog orbit
+// has drifted from the integrated one, the price of leaving out perturbations.
+inline void runEphemerisBenchmark(std::ostream& out, size_t particleCount = 20000, unsigned int seed = 42) {
+	const double spans[] = { 1.0, 10.0, 100.0, 1e4, 1e6 };
+	const double maxIntegratedYears = 10.0;
+	const size_t earth = 3;
+
+	ThreadPool pool(std::thread::hardware_concurrency());
+
+	out << std::setw(10) << "years"
+		<< std::setw(14) << "rails(ms)"
+		<< std::setw(16) << "integrated(ms)"
+		<< std::setw(18) << "earth offset(km)" << std::endl;
+
+	for (double years : spans) {
+		srand(seed);
+		BodySystem bodies;
+		bodies.pool = &pool;
+		buildSolarSystem(bodies);
+		addAsteroidBeltParticles(bodies, particleCount);
+
+		KeplerEphemeris ephemeris(bodies, 0.0);
+		const std::vector<PlanetData>& catalog = solarSystemCatalog();
+		for (size_t i = 0; i < catalog.size(); i++) ephemeris.useCatalogOrbit(bodies, i, catalog[i]);
+
+		BodySystem rails = bodies;
+		auto start = std::chrono::steady_clock::now();
+		ephemeris.evaluate(Seconds(Years(years)).value(), rails);
+		double railsMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		out << std::setw(10) << years
+			<< std::setw(14) << std::fixed << std::setprecision(3) << railsMs;
+
+		if (years <= maxIntegratedYears) {
+			std::unique_ptr<Integrator> integrator = makeIntegrator(IntegratorType::WisdomHolman);
+			integrator->maxSubstep = Days(8.0);
+			start = std::chrono::steady_clock::now();
+			integrator->advance(bodies, Years(years));
+			double integratedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			double dx = rails.x[earth] - bodies.x[earth];
+			double dy = rails.y[earth] - bodies.y[earth];
+			double dz = rails.z[earth] - bodies.z[earth];
+			out << std::setw(16) << std::setprecision(1) << integratedMs
+				<< std::setw(18) << std::setprecision(0) << Kilometers(Meters(std::sqrt(dx * dx + dy * dy + dz * dz))).value();
+		}
+		else {
+			out << std::setw(16) << "-" << std::setw(18) << "-";
+		}
+		out << std::defaultfloat << std::endl;
+	}
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef INTEGRATORFACTORY_H
+#define INTEGRATORFACTORY_H
+
+#include <Integrator.h>
+#include <BlockTimestep.h>
+#include <WisdomHolman.h>
+#include <memory>
+#include <string>
+
+inline std::unique_ptr<Integrator> makeIntegrator(IntegratorType type) {
+	switch (type) {
+	case IntegratorType::SemiImplicitEuler: return std::make_unique<SemiImplicitEulerIntegrator>();
+	case IntegratorType::Leapfrog: return std::make_unique<LeapfrogIntegrator>();
+	case IntegratorType::Yoshida4: return std::make_unique<Yoshida4Integrator>();
+	case IntegratorType::BlockTimestep: return std::make_unique<BlockTimestepIntegrator>();
+	case IntegratorType::WisdomHolman: return std::make_unique<WisdomHolmanIntegrator>();
+	case IntegratorType::VelocityVerlet:
+	default: return std::make_unique<VelocityVerletIntegrator>();
+	}
+}
+
+// Parse an integrator name as given on the command line, returns false if unknown
+inline bool parseIntegratorType(const std::string& name, IntegratorType& out) {
+	if (name == "euler") out = IntegratorType::SemiImplicitEuler;
+	else if (name == "leapfrog") out = IntegratorType::Leapfrog;
+	else if (name == "verlet") out = IntegratorType::VelocityVerlet;
+	else if (name == "yoshida4" || name == "forest-ruth") out = IntegratorType::Yoshida4;
+	else if (name == "block") out = IntegratorType::BlockTimestep;
+	else if (name == "wh" || name == "wisdom-holman") out = IntegratorType::WisdomHolman;
+	else return false;
+	return true;
+}
+
+#endif
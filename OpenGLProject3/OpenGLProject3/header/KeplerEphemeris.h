@@ -0,0 +1,294 @@
+#ifndef KEPLEREPHEMERIS_H
+#define KEPLEREPHEMERIS_H
+
+#include <BodySystem.h>
+#include <PlanetData.h>
+#include <ThreadPool.h>
+#include <Units.h>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+// Newton iterations on Kepler's equation that reach double precision for every
+// eccentricity up to maxE, starting from Danby's guess E = M + 0.85 e sign(M).
+// The count is the same for a whole batch, so the solver loop has no
+// data-dependent exit and the compiler can vectorize it, sin and cos included.
+inline int keplerIterations(double maxE) {
+	if (maxE < 0.3) return 3;
+	if (maxE < 0.7) return 4;
+	if (maxE < 0.8) return 5;
+	if (maxE < 0.95) return 6;
+	return 7;
+}
+
+// Keplerian orbits around one central body, structure of arrays. Each orbit is
+// stored by its periapsis direction P and the in-plane direction Q a quarter turn
+// ahead, so evaluating it at any time is one Kepler solve and two axpys.
+struct KeplerOrbits {
+	// Orbits with e at or above this are too slow to solve, they are left off the rails
+	static constexpr double MAX_ECCENTRICITY = 0.99;
+
+	// Body or particle index each orbit drives
+	std::vector<size_t> index;
+
+	std::vector<double> semiMajor, semiMinor, eccentricity;
+
+	// Mean anomaly at the epoch (rad) and mean motion (rad/s)
+	std::vector<double> meanAnomaly, meanMotion;
+
+	std::vector<double> px, py, pz;
+	std::vector<double> qx, qy, qz;
+
+	// Largest eccentricity of any orbit, sets the solver iterations
+	double maxEccentricity = 0.0;
+
+	size_t size() const {
+		return index.size();
+	}
+
+	void clear() {
+		*this = KeplerOrbits();
+	}
+
+	// Orbit k from its elements, P and Q unit vectors
+	void set(size_t k, double a, double e, const double P[3], const double Q[3], double M0, double n) {
+		semiMajor[k] = a;
+		semiMinor[k] = a * std::sqrt(1.0 - e * e);
+		eccentricity[k] = e;
+		meanAnomaly[k] = M0;
+		meanMotion[k] = n;
+		px[k] = P[0]; py[k] = P[1]; pz[k] = P[2];
+		qx[k] = Q[0]; qy[k] = Q[1]; qz[k] = Q[2];
+		maxEccentricity = std::max(maxEccentricity, e);
+	}
+
+	size_t add(size_t i) {
+		index.push_back(i);
+		for (std::vector<double>* v : { &semiMajor, &semiMinor, &eccentricity, &meanAnomaly, &meanMotion,
+			&px, &py, &pz, &qx, &qy, &qz }) {
+			v->push_back(0.0);
+		}
+		return index.size() - 1;
+	}
+
+	// Osculating orbit of a state relative to the central body with gravitational
+	// parameter mu. Returns false for states that are unbound, too eccentric or
+	// sitting on the centre, which are not added.
+	bool addState(size_t i, double mu, double rx, double ry, double rz, double vx, double vy, double vz) {
+		const double r = std::sqrt(rx * rx + ry * ry + rz * rz);
+		if (r == 0.0) return false;
+		const double v2 = vx * vx + vy * vy + vz * vz;
+		const double inverseA = 2.0 / r - v2 / mu;
+		if (inverseA <= 0.0) return false;
+		const double a = 1.0 / inverseA;
+
+		// Angular momentum h = r x v and eccentricity vector (v x h) / mu - r / |r|
+		const double hx = ry * vz - rz * vy;
+		const double hy = rz * vx - rx * vz;
+		const double hz = rx * vy - ry * vx;
+		const double h = std::sqrt(hx * hx + hy * hy + hz * hz);
+		if (h == 0.0) return false;
+		double ex = (vy * hz - vz * hy) / mu - rx / r;
+		double ey = (vz * hx - vx * hz) / mu - ry / r;
+		double ez = (vx * hy - vy * hx) / mu - rz / r;
+		double e = std::sqrt(ex * ex + ey * ey + ez * ez);
+		if (e >= MAX_ECCENTRICITY) return false;
+
+		// A circular orbit has no periapsis, measure from the current position instead
+		double P[3];
+		if (e < 1e-12) {
+			e = 0.0;
+			P[0] = rx / r; P[1] = ry / r; P[2] = rz / r;
+		}
+		else {
+			P[0] = ex / e; P[1] = ey / e; P[2] = ez / e;
+		}
+		const double Q[3] = {
+			(hy * P[2] - hz * P[1]) / h,
+			(hz * P[0] - hx * P[2]) / h,
+			(hx * P[1] - hy * P[0]) / h
+		};
+
+		// True anomaly to eccentric to mean anomaly
+		const double cosNu = (rx * P[0] + ry * P[1] + rz * P[2]) / r;
+		const double sinNu = (rx * Q[0] + ry * Q[1] + rz * Q[2]) / r;
+		const double E = std::atan2(std::sqrt(1.0 - e * e) * sinNu, e + cosNu);
+
+		set(add(i), a, e, P, Q, E - e * std::sin(E), std::sqrt(mu * inverseA * inverseA * inverseA));
+		return true;
+	}
+
+	// Positions and velocities relative to the central body dt seconds after the
+	// epoch for orbits [begin, end), written to the outputs from offset 0
+	void evaluate(double dt, size_t begin, size_t end, double* x, double* y, double* z,
+		double* vx, double* vy, double* vz) const {
+		const double TWO_PI = 2.0 * 3.14159265358979323846;
+		const int iterations = keplerIterations(maxEccentricity);
+
+		for (size_t k = begin; k < end; k++) {
+			const double e = eccentricity[k];
+
+			// Whole revolutions are dropped first, so a date millions of years
+			// away costs the same as the next tick
+			double M = meanAnomaly[k] + meanMotion[k] * dt;
+			M -= TWO_PI * std::floor(M / TWO_PI + 0.5);
+
+			double E = M + std::copysign(0.85 * e, M);
+			for (int it = 0; it < iterations; it++) {
+				E -= (E - e * std::sin(E) - M) / (1.0 - e * std::cos(E));
+			}
+
+			const double c = std::cos(E);
+			const double s = std::sin(E);
+			const double rate = meanMotion[k] / (1.0 - e * c);
+
+			// In-plane coordinates along P and Q, and their time derivatives
+			const double u = semiMajor[k] * (c - e);
+			const double w = semiMinor[k] * s;
+			const double du = -semiMajor[k] * s * rate;
+			const double dw = semiMinor[k] * c * rate;
+
+			const size_t o = k - begin;
+			x[o] = px[k] * u + qx[k] * w;
+			y[o] = py[k] * u + qy[k] * w;
+			z[o] = pz[k] * u + qz[k] * w;
+			vx[o] = px[k] * du + qx[k] * dw;
+			vy[o] = py[k] * du + qy[k] * dw;
+			vz[o] = pz[k] * du + qz[k] * dw;
+		}
+	}
+};
+
+// "On rails" mode: every body and test particle follows a fixed Kepler orbit
+// around the central body instead of being integrated, so the state at any date
+// is evaluated in closed form. No mutual perturbations, but seeking to any time,
+// however far away, costs one pass over the orbits.
+//
+// The central body (the most massive one) stays at rest where it was at the epoch.
+// Bodies whose orbit cannot be put on rails keep their last state.
+class KeplerEphemeris {
+private:
+	static constexpr size_t GRAIN = 256;
+
+	// Evaluate a batch of orbits into a scratch block, then scatter it to the
+	// indexed state arrays offset by the central body's position
+	static void evaluateInto(const KeplerOrbits& orbits, double dt, const double centre[3],
+		std::vector<double>& x, std::vector<double>& y, std::vector<double>& z,
+		std::vector<double>& vx, std::vector<double>& vy, std::vector<double>& vz, ThreadPool* pool) {
+		auto batch = [&](size_t begin, size_t end) {
+			double bx[GRAIN], by[GRAIN], bz[GRAIN], bvx[GRAIN], bvy[GRAIN], bvz[GRAIN];
+			orbits.evaluate(dt, begin, end, bx, by, bz, bvx, bvy, bvz);
+			for (size_t k = begin; k < end; k++) {
+				const size_t i = orbits.index[k];
+				const size_t o = k - begin;
+				x[i] = centre[0] + bx[o];
+				y[i] = centre[1] + by[o];
+				z[i] = centre[2] + bz[o];
+				vx[i] = bvx[o];
+				vy[i] = bvy[o];
+				vz[i] = bvz[o];
+			}
+		};
+
+		if (pool)
+			pool->parallelFor(0, orbits.size(), GRAIN, batch);
+		else
+			for (size_t b = 0; b < orbits.size(); b += GRAIN) batch(b, std::min(orbits.size(), b + GRAIN));
+	}
+
+public:
+	// Simulated seconds the orbits' mean anomalies refer to
+	double epoch = 0.0;
+
+	size_t central = 0;
+	double centre[3] = { 0.0, 0.0, 0.0 };
+
+	// G * mass of the central body
+	double mu = 0.0;
+
+	KeplerOrbits bodyOrbits, particleOrbits;
+
+	KeplerEphemeris() {}
+
+	KeplerEphemeris(const BodySystem& bodies, double epoch) {
+		build(bodies, epoch);
+	}
+
+	// Osculating orbits of every body and particle around the most massive body
+	// at time epoch, so switching to rails continues the current motion
+	void build(const BodySystem& bodies, double epoch) {
+		this->epoch = epoch;
+		bodyOrbits.clear();
+		particleOrbits.clear();
+		if (bodies.size() == 0) return;
+
+		central = 0;
+		for (size_t i = 1; i < bodies.size(); i++) {
+			if (bodies.mass[i] > bodies.mass[central]) central = i;
+		}
+		centre[0] = bodies.x[central];
+		centre[1] = bodies.y[central];
+		centre[2] = bodies.z[central];
+		mu = BodySystem::G * bodies.mass[central];
+		const double cvx = bodies.vx[central], cvy = bodies.vy[central], cvz = bodies.vz[central];
+
+		for (size_t i = 0; i < bodies.size(); i++) {
+			if (i == central) continue;
+			bodyOrbits.addState(i, mu,
+				bodies.x[i] - centre[0], bodies.y[i] - centre[1], bodies.z[i] - centre[2],
+				bodies.vx[i] - cvx, bodies.vy[i] - cvy, bodies.vz[i] - cvz);
+		}
+
+		const TestParticles& particles = bodies.particles;
+		particleOrbits.index.reserve(particles.size());
+		for (size_t k = 0; k < particles.size(); k++) {
+			particleOrbits.addState(k, mu,
+				particles.x[k] - centre[0], particles.y[k] - centre[1], particles.z[k] - centre[2],
+				particles.vx[k] - cvx, particles.vy[k] - cvy, particles.vz[k] - cvz);
+		}
+	}
+
+	// Replace a body's orbit with the catalog one: circular at distanceFromSun
+	// with the catalog period, in the plane addPlanetBody uses for that inclination.
+	// Only the phase comes from the body's current position.
+	void useCatalogOrbit(const BodySystem& bodies, size_t body, const PlanetData& data) {
+		if (body == central || data.orbitalPeriod <= 0.0f) return;
+
+		const double inclination = data.inclination * (3.14159265358979323846 / 180.0);
+		const double P[3] = { std::cos(inclination), std::sin(inclination), 0.0 };
+		const double Q[3] = { 0.0, 0.0, 1.0 };
+		const double rx = bodies.x[body] - centre[0];
+		const double ry = bodies.y[body] - centre[1];
+		const double rz = bodies.z[body] - centre[2];
+		const double phase = std::atan2(rx * Q[0] + ry * Q[1] + rz * Q[2], rx * P[0] + ry * P[1] + rz * P[2]);
+		const double n = 2.0 * 3.14159265358979323846 / Seconds(Years(data.orbitalPeriod)).value();
+
+		size_t k = 0;
+		while (k < bodyOrbits.size() && bodyOrbits.index[k] != body) k++;
+		if (k == bodyOrbits.size()) k = bodyOrbits.add(body);
+		bodyOrbits.set(k, data.distanceFromSun, 0.0, P, Q, phase, n);
+	}
+
+	// Write the state at the given simulated time into the system
+	void evaluate(double time, BodySystem& bodies) const {
+		if (bodies.size() == 0) return;
+		const double dt = time - epoch;
+
+		bodies.x[central] = centre[0];
+		bodies.y[central] = centre[1];
+		bodies.z[central] = centre[2];
+		bodies.vx[central] = 0.0;
+		bodies.vy[central] = 0.0;
+		bodies.vz[central] = 0.0;
+
+		evaluateInto(bodyOrbits, dt, centre, bodies.x, bodies.y, bodies.z,
+			bodies.vx, bodies.vy, bodies.vz, bodies.pool);
+
+		TestParticles& particles = bodies.particles;
+		evaluateInto(particleOrbits, dt, centre, particles.x, particles.y, particles.z,
+			particles.vx, particles.vy, particles.vz, bodies.pool);
+	}
+};
+
+#endif
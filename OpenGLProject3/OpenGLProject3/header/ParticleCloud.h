@@ -0,0 +1,63 @@
+#ifndef PARTICLECLOUD_H
+#define PARTICLECLOUD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <vector>
+#include <Shader.h>
+
+// Draws the test particles as points, one vertex per particle
+class ParticleCloud {
+private:
+	size_t capacity = 0;
+
+public:
+	GLuint vaoId = 0;
+	GLuint vboId = 0;
+	glm::vec3 color = glm::vec3(0.6f, 0.55f, 0.5f);
+
+	ParticleCloud() {
+		glGenVertexArrays(1, &vaoId);
+		glBindVertexArray(vaoId);
+
+		glGenBuffers(1, &vboId);
+		glBindBuffer(GL_ARRAY_BUFFER, vboId);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(float), (void*)0);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	~ParticleCloud() {
+		glDeleteVertexArrays(1, &vaoId);
+		glDeleteBuffers(1, &vboId);
+	}
+
+	// vertices holds interleaved xyz in render units
+	void draw(Shader& shader, const std::vector<float>& vertices) {
+		const size_t n = vertices.size() / 3;
+		if (n == 0) return;
+
+		glBindBuffer(GL_ARRAY_BUFFER, vboId);
+		if (n > capacity) {
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
+			capacity = n;
+		}
+		else {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		shader.setVec3(Uniform::Color, color);
+		shader.setMat4(Uniform::Model, glm::mat4(1.0f));
+
+		glBindVertexArray(vaoId);
+		glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(n));
+		glBindVertexArray(0);
+	}
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PLANETDATA_H
+#define PLANETDATA_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+
+struct PlanetData {
+	std::string name;
+	double mass;            // in kg
+	double radius;          // in meters
+	double distanceFromSun; // in meters
+	double orbitalPeriod;   // in Earth years
+	glm::vec3 color;        // RGB color for visualization
+	double inclination;     // in degrees
+
+	// Explicit heliocentric state in m and m/s, used instead of the circular
+	// orbit above when set
+	bool hasState = false;
+	glm::dvec3 position = glm::dvec3(0.0);
+	glm::dvec3 velocity = glm::dvec3(0.0);
+};
+
+// Shared solar system catalog, one copy for the whole program
+inline const std::vector<PlanetData>& solarSystemCatalog() {
+	static const std::vector<PlanetData> planets = {
+		// Name,Mass (kg),Radius (m),Distance from Sun (m), Orbital Period (years), Color (RGB), inclination (degrees)
+		{"Sun", 1.989e30, 6.96e8, 0.0, 0.0, glm::vec3(1.0f, 1.0f, 0.0f), 0.0},
+		{"Mercury", 3.3011e23, 2.4397e6, 57.91e9, 0.387, glm::vec3(0.7f, 0.7f, 0.7f), 7.0},
+		{"Venus", 4.8675e24, 6.0518e6, 108.21e9, 0.723, glm::vec3(0.9f, 0.7f, 0.5f), 3.39},
+		{"Earth", 5.972e24, 6.371e6, 149.60e9, 1.0, glm::vec3(0.2f, 0.5f, 0.8f), 0.0},
+		{"Mars", 6.4171e23, 3.3895e6, 227.92e9, 1.524, glm::vec3(0.8f, 0.3f, 0.2f), 1.85},
+		{"Jupiter", 1.8982e27, 6.9911e7, 778.57e9, 5.203, glm::vec3(0.8f, 0.7f, 0.5f), 1.31},
+		{"Saturn", 5.6834e26, 5.8232e7, 1.4335e12, 9.537, glm::vec3(0.9f, 0.8f, 0.6f), 2.49},
+		{"Uranus", 8.6810e25, 2.5362e7, 2.8725e12, 19.191, glm::vec3(0.5f, 0.8f, 0.8f), 0.77},
+		{"Neptune", 1.02413e26, 2.4622e7, 4.4951e12, 30.07, glm::vec3(0.3f, 0.4f, 0.9f), 1.77}
+	};
+	return planets;
+}
+
+// Look up a catalog entry by name, defaults to the first entry if not found
+inline const PlanetData& findPlanetData(const std::string& name) {
+	const std::vector<PlanetData>& planets = solarSystemCatalog();
+	for (const auto& planet : planets) {
+		if (planet.name == name)
+			return planet;
+	}
+	return planets[0];
+}
+
+#endif
@@ -2,18 +2,92 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Binding point of the Camera uniform block, see CameraBuffer.h
+const GLuint CAMERA_BLOCK_BINDING = 0;
+
+// Uniforms set on every draw. Their locations are looked up once when the
+// program is linked, so drawing indexes a table instead of asking the driver
+// for a location by name each time. A program without one gets -1 and the
+// setter does nothing, as glUniform does for location -1.
+enum class Uniform {
+	Model,
+	Color,
+	Position,
+	ScreenSize,
+	Radius,
+	Count
+};
+
+// Names in the GLSL sources, in Uniform order
+inline const char* uniformName(Uniform uniform) {
+	static const char* const names[] = { "model", "ourColor", "position", "screenSize", "radius" };
+	return names[static_cast<int>(uniform)];
+}
+
+// An active uniform outside any block, as reported by the driver at link time
+struct ShaderUniform {
+	std::string name;   // without a trailing [0] for arrays
+	GLint location;
+	GLenum type;
+	GLint size;
+};
+
 class Shader
 {
+private:
+	GLint locations[static_cast<int>(Uniform::Count)];
+
+	// Find every active uniform and block. Uniforms in blocks have no location,
+	// their values come from the buffer bound to the block.
+	void reflect() {
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+		for (GLint i = 0; i < count; i++) {
+			GLsizei length = 0;
+			ShaderUniform uniform;
+			glGetActiveUniform(ID, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &uniform.size, &uniform.type, name.data());
+			uniform.location = glGetUniformLocation(ID, name.data());
+			if (uniform.location < 0) continue;
+			uniform.name.assign(name.data(), length);
+			size_t bracket = uniform.name.find('[');
+			if (bracket != std::string::npos) uniform.name.resize(bracket);
+			uniforms.push_back(uniform);
+		}
+		for (int u = 0; u < static_cast<int>(Uniform::Count); u++) {
+			locations[u] = uniformLocation(uniformName(static_cast<Uniform>(u)));
+		}
+
+		GLint blockCount = 0, maxBlockLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockLength);
+		std::vector<GLchar> blockName(maxBlockLength > 0 ? maxBlockLength : 1);
+		for (GLint b = 0; b < blockCount; b++) {
+			GLsizei length = 0;
+			glGetActiveUniformBlockName(ID, static_cast<GLuint>(b), static_cast<GLsizei>(blockName.size()), &length, blockName.data());
+			blocks.emplace_back(blockName.data(), length);
+			if (blocks.back() == "Camera") glUniformBlockBinding(ID, static_cast<GLuint>(b), CAMERA_BLOCK_BINDING);
+		}
+	}
+
 public:
 	// the program ID
 	unsigned int ID;
 
+	// Active uniforms and uniform blocks, filled when the program is linked
+	std::vector<ShaderUniform> uniforms;
+	std::vector<std::string> blocks;
+
 	// constructor reads and builds the shader
 	Shader(const char* vertexPath, const char* fragmentPath) {
 		// 1. retrieve the vertex/fragment source code from filePath
@@ -93,6 +167,8 @@ public:
 		// delete the shaders as they're linked into our program now and no longer necessary
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+
+		reflect();
 	}
 
 	// use/activate shader
@@ -100,17 +176,46 @@ public:
 		glUseProgram(ID);
 	}
 
-	// utility uniform functions
+	// Location of an active uniform from the reflected table, -1 when the program has none
+	GLint uniformLocation(const std::string& name) const {
+		for (const ShaderUniform& uniform : uniforms) {
+			if (uniform.name == name) return uniform.location;
+		}
+		return -1;
+	}
+
+	GLint uniformLocation(Uniform uniform) const {
+		return locations[static_cast<int>(uniform)];
+	}
+
+	// Typed setters for the per-draw uniforms, on the program in use
+	void setMat4(Uniform uniform, const glm::mat4& value) const {
+		glUniformMatrix4fv(uniformLocation(uniform), 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setVec3(Uniform uniform, const glm::vec3& value) const {
+		glUniform3f(uniformLocation(uniform), value.x, value.y, value.z);
+	}
+
+	void setVec2(Uniform uniform, const glm::vec2& value) const {
+		glUniform2f(uniformLocation(uniform), value.x, value.y);
+	}
+
+	void setFloat(Uniform uniform, float value) const {
+		glUniform1f(uniformLocation(uniform), value);
+	}
+
+	// utility uniform functions, by name through the reflected table
 	void setBool(const std::string& name, bool value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(uniformLocation(name), (int)value);
 	}
 	
 	void setInt(const std::string& name, int value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(uniformLocation(name), value);
 	}
 	
 	void setFloat(const std::string& name, float value) const {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(uniformLocation(name), value);
 	}
 };
 
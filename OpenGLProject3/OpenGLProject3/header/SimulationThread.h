@@ -0,0 +1,373 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include <glm/glm.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <BodySystem.h>
+#include <Integrator.h>
+#include <Checkpoint.h>
+#include <ConservationMonitor.h>
+#include <KeplerEphemeris.h>
+#include <HistoryCache.h>
+#include <mutex>
+#include <functional>
+#include <string>
+#include <iostream>
+
+// Positions at the start and end of one simulation tick, in render units (see Units.h).
+// The renderer blends the two, so motion stays smooth between ticks.
+struct RenderSnapshot {
+	// Simulated seconds at the end of the tick
+	double simTime = 0.0;
+
+	// Wall clock time the tick was published
+	std::chrono::steady_clock::time_point published;
+
+	// Interleaved xyz per body and per test particle
+	std::vector<float> previous, current;
+	std::vector<float> particlePrevious, particleCurrent;
+
+	bool hasBody(size_t i) const {
+		return 3 * i + 2 < current.size();
+	}
+
+	glm::vec3 bodyPosition(size_t i, float alpha) const {
+		glm::vec3 a(previous[3 * i], previous[3 * i + 1], previous[3 * i + 2]);
+		glm::vec3 b(current[3 * i], current[3 * i + 1], current[3 * i + 2]);
+		return a + (b - a) * alpha;
+	}
+
+	void particlePositions(float alpha, std::vector<float>& out) const {
+		out.resize(particleCurrent.size());
+		for (size_t k = 0; k < out.size(); k++) {
+			out[k] = particlePrevious[k] + (particleCurrent[k] - particlePrevious[k]) * alpha;
+		}
+	}
+};
+
+// Lock-free triple buffer: the writer fills its back slot and swaps it with
+// the middle one, the reader swaps its front slot with the middle one when a
+// new snapshot is waiting. Neither side ever waits for the other.
+class SnapshotTripleBuffer {
+private:
+	static const int INDEX_MASK = 3;
+	static const int FRESH = 4;
+
+	RenderSnapshot slots[3];
+	std::atomic<int> middle{ 1 };
+	int back = 0;
+	int front = 2;
+
+public:
+	// Writer side
+	RenderSnapshot& writeSlot() {
+		return slots[back];
+	}
+
+	void publish() {
+		back = middle.exchange(back | FRESH) & INDEX_MASK;
+	}
+
+	// Reader side, the returned snapshot stays untouched until the next call
+	const RenderSnapshot& latest() {
+		if (middle.load() & FRESH) {
+			front = middle.exchange(front) & INDEX_MASK;
+		}
+		return slots[front];
+	}
+};
+
+// Runs the integrator on its own thread at a fixed tick rate. Each tick
+// advances the same amount of simulated time, independent of the frame rate,
+// and publishes a snapshot. The BodySystem belongs to this thread between
+// start() and stop(); the renderer only reads snapshots.
+class SimulationThread {
+private:
+	BodySystem& bodies;
+	Integrator& integrator;
+
+	std::thread worker;
+	std::atomic<bool> running{ false };
+
+	SnapshotTripleBuffer buffers;
+
+	// Positions published last, the start of the next snapshot
+	std::vector<float> lastBodies, lastParticles;
+
+	double simTime = 0.0;
+
+	// Checkpoint requested by another thread, taken after the next tick
+	std::mutex checkpointMutex;
+	bool checkpointPending = false;
+	std::string checkpointPath;
+	CheckpointData checkpointData;
+	CheckpointWriter checkpointWriter;
+
+	void takeCheckpoint() {
+		std::lock_guard<std::mutex> lock(checkpointMutex);
+		if (!checkpointPending) return;
+		captureCheckpoint(bodies, simTime, checkpointData);
+		checkpointWriter.save(checkpointPath, std::move(checkpointData));
+		checkpointData = CheckpointData();
+		checkpointPending = false;
+	}
+
+	// Jump requested by another thread, applied before the next tick
+	std::mutex seekMutex;
+	bool seekPending = false;
+	double seekTime = 0.0;
+
+	// On rails any time is just evaluated. Otherwise the last keyframe before
+	// the target is restored and whole ticks are replayed from it, the same
+	// ticks the original run took, so the replay lands on the same states.
+	void takeSeek() {
+		double target;
+		{
+			std::lock_guard<std::mutex> lock(seekMutex);
+			if (!seekPending) return;
+			target = seekTime;
+			seekPending = false;
+		}
+
+		if (ephemeris) {
+			simTime = target;
+			return;
+		}
+
+		target = history->clampTime(target);
+		double keyframeTime;
+		if (!history->restore(target, bodies, keyframeTime)) return;
+		simTime = keyframeTime;
+
+		// The replay runs the clocks from the keyframe again
+		if (integrator.collisions) integrator.collisions->time = keyframeTime;
+		if (monitor) monitor->rewind(keyframeTime);
+
+		const double tick = tickSeconds().value();
+		while (simTime + 0.5 * tick <= target) {
+			integrator.advance(bodies, tickSeconds());
+			simTime += tick;
+		}
+		if (integrator.collisions) integrator.collisions->events.clear();
+	}
+
+	// Changes to the bodies requested by another thread, applied before the next tick
+	std::mutex editMutex;
+	std::vector<std::function<void(BodySystem&)>> pendingEdits;
+
+	// The keyframes before an edit hold other bodies, so the history starts over from it
+	void takeEdits() {
+		std::vector<std::function<void(BodySystem&)>> edits;
+		{
+			std::lock_guard<std::mutex> lock(editMutex);
+			if (pendingEdits.empty()) return;
+			edits.swap(pendingEdits);
+		}
+		for (auto& edit : edits) edit(bodies);
+		if (history) {
+			history->clear();
+			history->record(bodies, simTime);
+		}
+	}
+
+	// Integrate one tick, or on rails just evaluate the orbits at its end
+	void advance() {
+		takeSeek();
+		takeEdits();
+
+		if (ephemeris) {
+			simTime += tickSeconds().value();
+			ephemeris->evaluate(simTime, bodies);
+			return;
+		}
+
+		if (monitor) monitor->prepare(bodies, simTime + tickSeconds().value());
+		integrator.advance(bodies, tickSeconds());
+		simTime += tickSeconds().value();
+		if (history) history->record(bodies, simTime);
+	}
+
+	void reportConservation() const {
+		const ConservationSample& s = monitor->latest();
+		std::cout << "Day " << Days(Seconds(s.time)).value()
+			<< ": energy drift " << s.energyDrift
+			<< ", momentum drift " << s.momentumDrift
+			<< ", angular momentum drift " << s.angularDrift << std::endl;
+	}
+
+	// Collisions found by the integrator during the tick
+	void reportCollisions() {
+		std::vector<CollisionEvent>& events = integrator.collisions->events;
+		for (const CollisionEvent& event : events) {
+			if (event.type != EncounterType::Collision) continue;
+			std::cout << "Day " << Days(Seconds(event.time)).value() << ": bodies " << event.a << " and " << event.b
+				<< " collided at " << event.relativeSpeed << " m/s" << std::endl;
+		}
+		events.clear();
+	}
+
+	static void toRenderUnits(const std::vector<double>& x, const std::vector<double>& y,
+		const std::vector<double>& z, std::vector<float>& out) {
+		const size_t n = x.size();
+		out.resize(3 * n);
+		for (size_t i = 0; i < n; i++) {
+			out[3 * i + 0] = renderCoordinate(Meters(x[i]));
+			out[3 * i + 1] = renderCoordinate(Meters(y[i]));
+			out[3 * i + 2] = renderCoordinate(Meters(z[i]));
+		}
+	}
+
+	void publish() {
+		RenderSnapshot& snapshot = buffers.writeSlot();
+		snapshot.previous.swap(lastBodies);
+		snapshot.particlePrevious.swap(lastParticles);
+		toRenderUnits(bodies.x, bodies.y, bodies.z, snapshot.current);
+		toRenderUnits(bodies.particles.x, bodies.particles.y, bodies.particles.z, snapshot.particleCurrent);
+		// After bodies were added there is nothing to blend from
+		if (snapshot.previous.size() != snapshot.current.size()) snapshot.previous = snapshot.current;
+		lastBodies = snapshot.current;
+		lastParticles = snapshot.particleCurrent;
+
+		snapshot.simTime = simTime;
+		snapshot.published = std::chrono::steady_clock::now();
+		buffers.publish();
+	}
+
+	void run() {
+		const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(1.0 / tickRate));
+		auto next = std::chrono::steady_clock::now();
+
+		// The starting state is the first keyframe
+		if (history && !ephemeris) history->record(bodies, simTime);
+
+		while (running.load()) {
+			auto start = std::chrono::steady_clock::now();
+			advance();
+			if (monitor && !ephemeris && monitor->sample(bodies, simTime)) reportConservation();
+			if (integrator.collisions) reportCollisions();
+			publish();
+			takeCheckpoint();
+			lastTickMs.store(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+			// A slow tick is not caught up later, simulated time just runs slower
+			next += interval;
+			auto now = std::chrono::steady_clock::now();
+			if (next < now)
+				next = now;
+			else
+				std::this_thread::sleep_until(next);
+		}
+	}
+
+public:
+	// Ticks per wall clock second
+	const double tickRate;
+
+	// Simulated seconds per wall clock second
+	const double timeScale;
+
+	// Wall clock cost of the last tick
+	std::atomic<double> lastTickMs{ 0.0 };
+
+	// Optional, sampled and printed after the ticks it falls due on.
+	// Set before start(), belongs to the simulation thread while running.
+	ConservationMonitor* monitor = nullptr;
+
+	// Optional, when set the bodies follow these orbits instead of the integrator
+	// and the monitor is not sampled. Set before start().
+	const KeplerEphemeris* ephemeris = nullptr;
+
+	// Optional keyframes for seeking back through an integrated run.
+	// Set before start(), belongs to the simulation thread while running.
+	HistoryCache* history = nullptr;
+
+	SimulationThread(BodySystem& bodies, Integrator& integrator, double tickRate, double timeScale, double startTime = 0.0)
+		: bodies(bodies), integrator(integrator), simTime(startTime), tickRate(tickRate), timeScale(timeScale) {
+		// Initial state, so the renderer has a snapshot before the first tick
+		toRenderUnits(bodies.x, bodies.y, bodies.z, lastBodies);
+		toRenderUnits(bodies.particles.x, bodies.particles.y, bodies.particles.z, lastParticles);
+		publish();
+	}
+
+	~SimulationThread() {
+		stop();
+	}
+
+	SimulationThread(const SimulationThread&) = delete;
+	SimulationThread& operator=(const SimulationThread&) = delete;
+
+	// Simulated seconds per tick
+	Seconds tickSeconds() const {
+		return Seconds(timeScale / tickRate);
+	}
+
+	void start() {
+		if (running.exchange(true)) return;
+		worker = std::thread(&SimulationThread::run, this);
+	}
+
+	void stop() {
+		if (!running.exchange(false)) return;
+		worker.join();
+	}
+
+	// Save the state after the next tick to path, written in the background.
+	// data may already hold the trails, the bodies are filled in by the simulation.
+	void requestCheckpoint(const std::string& path, CheckpointData&& data) {
+		{
+			std::lock_guard<std::mutex> lock(checkpointMutex);
+			checkpointPath = path;
+			checkpointData = std::move(data);
+			checkpointPending = true;
+		}
+
+		// Nobody else owns the bodies while stopped
+		if (!running.load()) takeCheckpoint();
+	}
+
+	// Jump to a simulated time, taken at the next tick. On rails any date costs
+	// the same; when integrating it needs a history, and the target is clamped
+	// to the span it covers. Returns false when seeking is not possible.
+	bool seek(double time) {
+		if (!ephemeris && !history) return false;
+		std::lock_guard<std::mutex> lock(seekMutex);
+		seekTime = time;
+		seekPending = true;
+		return true;
+	}
+
+	// Change the bodies, e.g. add or remove one, before the next tick. Body
+	// indices are kept stable by the caller (see BodyEntities), so the render
+	// side can go on using them. Not on rails, where the orbits are fixed.
+	bool requestEdit(std::function<void(BodySystem&)> edit) {
+		if (ephemeris) return false;
+		{
+			std::lock_guard<std::mutex> lock(editMutex);
+			pendingEdits.push_back(std::move(edit));
+		}
+
+		// Nobody else owns the bodies while stopped
+		if (!running.load()) takeEdits();
+		return true;
+	}
+
+	// Render thread only
+	const RenderSnapshot& latest() {
+		return buffers.latest();
+	}
+
+	// Blend factor for a snapshot: how far the wall clock has moved into the
+	// tick after it was published. The renderer lags one tick behind the simulation.
+	float interpolation(const RenderSnapshot& snapshot) const {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - snapshot.published).count();
+		return static_cast<float>(std::clamp(elapsed * tickRate, 0.0, 1.0));
+	}
+};
+
+#endif
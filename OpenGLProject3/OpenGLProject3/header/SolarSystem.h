@@ -0,0 +1,165 @@
+#ifndef SOLARSYSTEM_H
+#define SOLARSYSTEM_H
+
+#include <glm/glm.hpp>
+#include <cstdlib>
+#include <cmath>
+#include <PlanetData.h>
+#include <BodySystem.h>
+
+// State of a circular orbit around the Sun at a random start angle, or the
+// origin for distance zero (the Sun itself). distance in m, inclination in degrees.
+inline void circularOrbitState(double distance, double inclination, glm::dvec3& position, glm::dvec3& velocity) {
+	// Initialize position and velocity in real units
+	position = glm::dvec3(0.0);
+	velocity = glm::dvec3(0.0);
+	if (distance <= 0.0) return;
+
+	// Convert inclination to radians
+	double inclinationRad = inclination * (3.14159265358979323846 / 180.0);
+
+	double startAngle = rand() / (double)RAND_MAX * 2.0 * 3.14159265358979323846;
+
+	// Position in orbital plane
+	double x = distance * cos(startAngle);
+	double z = distance * sin(startAngle);
+	double y = 0.0;
+
+	// Applying inclination rotation
+	position = glm::dvec3(
+		x * cos(inclinationRad) - y * sin(inclinationRad),
+		x * sin(inclinationRad) + y * sin(inclinationRad),
+		z
+	);
+
+	// Calculate orbital velocity in real units: v = sqrt(GM/r)
+	double orbitalSpeed = glm::sqrt((BodySystem::G * 1.989e30) / distance);
+
+	double vx = -sin(startAngle) * orbitalSpeed;
+	double vz = cos(startAngle) * orbitalSpeed;
+	double vy = 0.0;
+
+	velocity = glm::dvec3(
+		vx * cos(inclinationRad) - vy * sin(inclinationRad),
+		vx * sin(inclinationRad) + vy * sin(inclinationRad),
+		vz
+	);
+}
+
+// Add a body on a circular orbit, see circularOrbitState.
+// Needs no GL context, so it can be used by both the renderer and benchmarks.
+inline size_t addCircularOrbitBody(BodySystem& bodies, double mass, double radius, double distance, double inclination) {
+	glm::dvec3 position, velocity;
+	circularOrbitState(distance, inclination, position, velocity);
+	return bodies.addBody(mass,
+		position.x, position.y, position.z,
+		velocity.x, velocity.y, velocity.z,
+		radius);
+}
+
+// Starting state of a catalog body, its explicit state when it has one
+inline void planetBodyState(const PlanetData& data, glm::dvec3& position, glm::dvec3& velocity) {
+	if (data.hasState) {
+		position = data.position;
+		velocity = data.velocity;
+	}
+	else {
+		circularOrbitState(data.distanceFromSun, data.inclination, position, velocity);
+	}
+}
+
+// Add a catalog body, at its explicit state when it has one
+inline size_t addPlanetBody(BodySystem& bodies, const PlanetData& data) {
+	glm::dvec3 position, velocity;
+	planetBodyState(data, position, velocity);
+	return bodies.addBody(data.mass,
+		position.x, position.y, position.z,
+		velocity.x, velocity.y, velocity.z,
+		data.radius);
+}
+
+// Put a catalog body into index i, appending it when i is one past the end.
+// Used to fill the index of a removed body again.
+inline void placePlanetBody(BodySystem& bodies, size_t i, const PlanetData& data) {
+	if (i >= bodies.size()) {
+		while (bodies.size() < i) bodies.addBody(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+		addPlanetBody(bodies, data);
+		return;
+	}
+	glm::dvec3 position, velocity;
+	planetBodyState(data, position, velocity);
+	bodies.setBody(i, data.mass,
+		position.x, position.y, position.z,
+		velocity.x, velocity.y, velocity.z,
+		data.radius);
+}
+
+// Add every catalog body, in catalog order
+inline void buildSolarSystem(BodySystem& bodies) {
+	const std::vector<PlanetData>& planets = solarSystemCatalog();
+	bodies.reserve(bodies.size() + planets.size());
+	for (const auto& planet : planets) {
+		addPlanetBody(bodies, planet);
+	}
+}
+
+// Random circular orbit around the Sun between innerRadius and outerRadius (meters),
+// in the XZ plane tilted about the X axis by up to maxInclination degrees
+inline void randomBeltOrbit(double innerRadius, double outerRadius, double maxInclination,
+	double position[3], double velocity[3]) {
+	const double PI = 3.14159265358979323846;
+	const double SUN_MASS = 1.989e30;
+
+	double u = rand() / (double)RAND_MAX;
+	double distance = innerRadius + (outerRadius - innerRadius) * u;
+	double startAngle = rand() / (double)RAND_MAX * 2.0 * PI;
+	double inclinationRad = (rand() / (double)RAND_MAX * 2.0 - 1.0) * maxInclination * (PI / 180.0);
+
+	double orbitalSpeed = std::sqrt((BodySystem::G * SUN_MASS) / distance);
+
+	double x = distance * cos(startAngle);
+	double z = distance * sin(startAngle);
+	double vx = -sin(startAngle) * orbitalSpeed;
+	double vz = cos(startAngle) * orbitalSpeed;
+
+	position[0] = x;
+	position[1] = z * sin(inclinationRad);
+	position[2] = z * cos(inclinationRad);
+	velocity[0] = vx;
+	velocity[1] = vz * sin(inclinationRad);
+	velocity[2] = vz * cos(inclinationRad);
+}
+
+// Radius of a rocky sphere of mass m (kg), bulk density 2000 kg/m^3
+inline double asteroidRadius(double m) {
+	const double DENSITY = 2000.0;
+	return std::cbrt(3.0 * m / (4.0 * 3.14159265358979323846 * DENSITY));
+}
+
+// Add count small bodies on circular orbits between innerRadius and outerRadius (meters),
+// with random masses in [minMass, maxMass] kg and inclinations up to maxInclination degrees
+inline void addAsteroidBelt(BodySystem& bodies, size_t count,
+	double innerRadius = 3.29e11, double outerRadius = 4.94e11,
+	double minMass = 1e15, double maxMass = 1e20, double maxInclination = 10.0) {
+	bodies.reserve(bodies.size() + count);
+	for (size_t k = 0; k < count; k++) {
+		double p[3], v[3];
+		randomBeltOrbit(innerRadius, outerRadius, maxInclination, p, v);
+		double m = minMass + (maxMass - minMass) * (rand() / (double)RAND_MAX);
+
+		bodies.addBody(m, p[0], p[1], p[2], v[0], v[1], v[2], asteroidRadius(m));
+	}
+}
+
+// Same belt as massless test particles, which only feel the bodies
+inline void addAsteroidBeltParticles(BodySystem& bodies, size_t count,
+	double innerRadius = 3.29e11, double outerRadius = 4.94e11, double maxInclination = 10.0) {
+	bodies.particles.reserve(bodies.particles.size() + count);
+	for (size_t k = 0; k < count; k++) {
+		double p[3], v[3];
+		randomBeltOrbit(innerRadius, outerRadius, maxInclination, p, v);
+		bodies.particles.addParticle(p[0], p[1], p[2], v[0], v[1], v[2]);
+	}
+}
+
+#endif
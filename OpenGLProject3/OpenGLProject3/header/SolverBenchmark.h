@@ -0,0 +1,277 @@
+#ifndef SOLVERBENCHMARK_H
+#define SOLVERBENCHMARK_H
+
+#include <BodySystem.h>
+#include <SolarSystem.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+
+// Time of one direct-sum and one Barnes-Hut evaluation for growing body counts
+// (solar system plus an asteroid belt), the RMS relative error of the tree, and
+// the body count where the tree starts to win.
+inline void runSolverBenchmark(std::ostream& out, double theta = 0.5, size_t maxBodies = 131072,
+	size_t maxDirectBodies = 32768, unsigned int seed = 42) {
+	out << "Barnes-Hut opening angle " << theta << std::endl;
+	out << std::setw(10) << "bodies"
+		<< std::setw(14) << "direct(ms)"
+		<< std::setw(14) << "tree(ms)"
+		<< std::setw(12) << "nodes"
+		<< std::setw(16) << "rms rel error" << std::endl;
+
+	size_t crossover = 0;
+
+	for (size_t n = 256; n <= maxBodies; n *= 2) {
+		srand(seed);
+		BodySystem bodies;
+		buildSolarSystem(bodies);
+		addAsteroidBelt(bodies, n - bodies.size());
+		bodies.openingAngle = theta;
+
+		double directMs = -1.0;
+		std::vector<double> refX, refY, refZ;
+		if (n <= maxDirectBodies) {
+			auto start = std::chrono::steady_clock::now();
+			bodies.computeAccelerationsDirect();
+			directMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			refX = bodies.ax; refY = bodies.ay; refZ = bodies.az;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		bodies.computeAccelerationsTree();
+		double treeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		out << std::setw(10) << n;
+		if (directMs >= 0.0)
+			out << std::setw(14) << std::fixed << std::setprecision(2) << directMs;
+		else
+			out << std::setw(14) << "-";
+		out << std::setw(14) << std::fixed << std::setprecision(2) << treeMs
+			<< std::setw(12) << bodies.treeNodeCount();
+
+		if (directMs >= 0.0) {
+			double sumSq = 0.0;
+			for (size_t i = 0; i < n; i++) {
+				double ex = bodies.ax[i] - refX[i];
+				double ey = bodies.ay[i] - refY[i];
+				double ez = bodies.az[i] - refZ[i];
+				double ref = refX[i] * refX[i] + refY[i] * refY[i] + refZ[i] * refZ[i];
+				if (ref > 0.0) sumSq += (ex * ex + ey * ey + ez * ez) / ref;
+			}
+			out << std::setw(16) << std::scientific << std::setprecision(3) << std::sqrt(sumSq / n);
+
+			if (crossover == 0 && treeMs < directMs) crossover = n;
+		}
+		else {
+			out << std::setw(16) << "-";
+		}
+		out << std::defaultfloat << std::endl;
+	}
+
+	if (crossover > 0)
+		out << "Barnes-Hut is faster from about " << crossover << " bodies (barnesHutMinBodies)" << std::endl;
+	else
+		out << "Barnes-Hut was not faster in the measured range" << std::endl;
+}
+
+// Throughput of the direct-sum kernels and their largest relative deviation
+// from the scalar reference kernel
+inline void runKernelBenchmark(std::ostream& out, unsigned int seed = 42) {
+	const GravityKernel best = detectGravityKernel();
+	out << "Best kernel on this CPU: " << gravityKernelName(best) << std::endl;
+	out << std::setw(10) << "bodies"
+		<< std::setw(10) << "kernel"
+		<< std::setw(12) << "time(ms)"
+		<< std::setw(16) << "Mpairs/s"
+		<< std::setw(16) << "max rel error" << std::endl;
+
+	std::vector<GravityKernel> kernels = { GravityKernel::Scalar };
+	if (best == GravityKernel::AVX2 || best == GravityKernel::AVX512) kernels.push_back(GravityKernel::AVX2);
+	if (best == GravityKernel::AVX512) kernels.push_back(GravityKernel::AVX512);
+
+	for (size_t n = 1024; n <= 16384; n *= 4) {
+		srand(seed);
+		BodySystem bodies;
+		buildSolarSystem(bodies);
+		addAsteroidBelt(bodies, n - bodies.size());
+
+		std::vector<double> gm(n);
+		for (size_t i = 0; i < n; i++) gm[i] = BodySystem::G * bodies.mass[i];
+
+		std::vector<double> refX(n), refY(n), refZ(n);
+		gravityKernelScalar(bodies.x.data(), bodies.y.data(), bodies.z.data(), gm.data(),
+			n, 0, n, refX.data(), refY.data(), refZ.data());
+
+		for (GravityKernel kernel : kernels) {
+			std::vector<double> accX(n), accY(n), accZ(n);
+			auto start = std::chrono::steady_clock::now();
+			runGravityKernel(kernel, bodies.x.data(), bodies.y.data(), bodies.z.data(), gm.data(),
+				n, 0, n, accX.data(), accY.data(), accZ.data());
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			double maxError = 0.0;
+			for (size_t i = 0; i < n; i++) {
+				double ref = std::sqrt(refX[i] * refX[i] + refY[i] * refY[i] + refZ[i] * refZ[i]);
+				double ex = accX[i] - refX[i], ey = accY[i] - refY[i], ez = accZ[i] - refZ[i];
+				if (ref > 0.0) maxError = std::max(maxError, std::sqrt(ex * ex + ey * ey + ez * ez) / ref);
+			}
+
+			out << std::setw(10) << n
+				<< std::setw(10) << gravityKernelName(kernel)
+				<< std::setw(12) << std::fixed << std::setprecision(2) << ms
+				<< std::setw(16) << std::setprecision(1) << (double)n * n / (ms * 1e3)
+				<< std::setw(16) << std::scientific << std::setprecision(3) << maxError
+				<< std::defaultfloat << std::endl;
+		}
+	}
+}
+
+// Scaling of the direct sum and the tree walk over thread counts. The results
+// must match the single-threaded run bit for bit.
+inline void runThreadBenchmark(std::ostream& out, size_t bodyCount = 32768, unsigned int seed = 42) {
+	const size_t maxThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	out << bodyCount << " bodies, kernel " << gravityKernelName(detectGravityKernel()) << std::endl;
+	out << std::setw(10) << "threads"
+		<< std::setw(14) << "direct(ms)"
+		<< std::setw(12) << "speedup"
+		<< std::setw(14) << "tree(ms)"
+		<< std::setw(12) << "speedup"
+		<< std::setw(12) << "identical" << std::endl;
+
+	srand(seed);
+	BodySystem bodies;
+	buildSolarSystem(bodies);
+	addAsteroidBelt(bodies, bodyCount - bodies.size());
+
+	std::vector<double> directRef, treeRef;
+	double directBase = 0.0, treeBase = 0.0;
+
+	for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+		ThreadPool pool(threads);
+		bodies.pool = &pool;
+
+		auto start = std::chrono::steady_clock::now();
+		bodies.computeAccelerationsDirect();
+		double directMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::vector<double> direct = bodies.ax;
+		direct.insert(direct.end(), bodies.ay.begin(), bodies.ay.end());
+		direct.insert(direct.end(), bodies.az.begin(), bodies.az.end());
+
+		start = std::chrono::steady_clock::now();
+		bodies.computeAccelerationsTree();
+		double treeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::vector<double> tree = bodies.ax;
+		tree.insert(tree.end(), bodies.ay.begin(), bodies.ay.end());
+		tree.insert(tree.end(), bodies.az.begin(), bodies.az.end());
+
+		if (threads == 1) {
+			directRef = direct; treeRef = tree;
+			directBase = directMs; treeBase = treeMs;
+		}
+
+		out << std::setw(10) << threads
+			<< std::setw(14) << std::fixed << std::setprecision(2) << directMs
+			<< std::setw(12) << directBase / directMs
+			<< std::setw(14) << treeMs
+			<< std::setw(12) << treeBase / treeMs
+			<< std::setw(12) << (direct == directRef && tree == treeRef ? "yes" : "NO")
+			<< std::defaultfloat << std::endl;
+
+		bodies.pool = nullptr;
+	}
+}
+
+// Largest and RMS relative deviation of (ax, ay, az) from (refX, refY, refZ)
+inline void accelerationError(const std::vector<double>& refX, const std::vector<double>& refY, const std::vector<double>& refZ,
+	const std::vector<double>& ax, const std::vector<double>& ay, const std::vector<double>& az,
+	double& maxError, double& rmsError) {
+	maxError = 0.0;
+	double sumSq = 0.0;
+	size_t counted = 0;
+	for (size_t i = 0; i < refX.size(); i++) {
+		double ref = std::sqrt(refX[i] * refX[i] + refY[i] * refY[i] + refZ[i] * refZ[i]);
+		if (ref <= 0.0) continue;
+		double ex = ax[i] - refX[i], ey = ay[i] - refY[i], ez = az[i] - refZ[i];
+		double error = std::sqrt(ex * ex + ey * ey + ez * ez) / ref;
+		maxError = std::max(maxError, error);
+		sumSq += error * error;
+		counted++;
+	}
+	rmsError = counted > 0 ? std::sqrt(sumSq / counted) : 0.0;
+}
+
+// Mixed-precision force passes against the full double ones, with the best
+// kernel: direct sums over growing body counts, then test particles pulled by
+// the solar system. Reports the speedup and the relative acceleration error.
+inline void runPrecisionBenchmark(std::ostream& out, size_t particleCount = 262144, unsigned int seed = 42) {
+	const GravityKernel kernel = detectGravityKernel();
+	out << "Kernel " << gravityKernelName(kernel) << std::endl;
+	out << std::setw(10) << "bodies"
+		<< std::setw(10) << "targets"
+		<< std::setw(14) << "double(ms)"
+		<< std::setw(14) << "mixed(ms)"
+		<< std::setw(10) << "speedup"
+		<< std::setw(16) << "max rel error"
+		<< std::setw(16) << "rms rel error" << std::endl;
+
+	auto report = [&](size_t sources, size_t targets, double doubleMs, double mixedMs, double maxError, double rmsError) {
+		out << std::setw(10) << sources
+			<< std::setw(10) << targets
+			<< std::setw(14) << std::fixed << std::setprecision(2) << doubleMs
+			<< std::setw(14) << mixedMs
+			<< std::setw(10) << doubleMs / mixedMs
+			<< std::scientific << std::setprecision(3)
+			<< std::setw(16) << maxError
+			<< std::setw(16) << rmsError
+			<< std::defaultfloat << std::endl;
+	};
+
+	for (size_t n = 1024; n <= 16384; n *= 4) {
+		srand(seed);
+		BodySystem bodies;
+		bodies.gravityKernel = kernel;
+		buildSolarSystem(bodies);
+		addAsteroidBelt(bodies, n - bodies.size());
+
+		auto start = std::chrono::steady_clock::now();
+		bodies.computeAccelerationsDirect();
+		double doubleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::vector<double> refX = bodies.ax, refY = bodies.ay, refZ = bodies.az;
+
+		bodies.forcePrecision = ForcePrecision::Mixed;
+		start = std::chrono::steady_clock::now();
+		bodies.computeAccelerationsDirect();
+		double mixedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		double maxError, rmsError;
+		accelerationError(refX, refY, refZ, bodies.ax, bodies.ay, bodies.az, maxError, rmsError);
+		report(n, n, doubleMs, mixedMs, maxError, rmsError);
+	}
+
+	srand(seed);
+	BodySystem bodies;
+	buildSolarSystem(bodies);
+	addAsteroidBeltParticles(bodies, particleCount);
+	TestParticles& particles = bodies.particles;
+
+	auto start = std::chrono::steady_clock::now();
+	bodies.computeParticleAccelerations();
+	double doubleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::vector<double> refX = particles.ax, refY = particles.ay, refZ = particles.az;
+
+	particles.precision = ForcePrecision::Mixed;
+	start = std::chrono::steady_clock::now();
+	bodies.computeParticleAccelerations();
+	double mixedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	double maxError, rmsError;
+	accelerationError(refX, refY, refZ, particles.ax, particles.ay, particles.az, maxError, rmsError);
+	report(bodies.size(), particleCount, doubleMs, mixedMs, maxError, rmsError);
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef SPHEREINSTANCES_H
+#define SPHEREINSTANCES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <Sphere.h>
+
+// Per sphere data for one instanced draw: centre in render units, radius and colour
+struct SphereInstance {
+	glm::vec3 position;
+	float scale;
+	glm::vec3 color;
+};
+
+static_assert(sizeof(SphereInstance) == 7 * sizeof(float), "instance attributes are read tightly packed");
+
+// Draws any number of spheres with one unit-sphere mesh and a single
+// glDrawElementsInstanced call. The per-instance buffer is refilled every draw
+// and only reallocated when it grows, like the particle cloud's.
+// Use with instanced.vert / instanced.frag.
+class SphereInstances {
+private:
+	// Vertex attributes: 0 the mesh position, 1 centre and radius, 2 colour
+	static const GLuint MESH_POSITION = 0;
+	static const GLuint INSTANCE_PLACEMENT = 1;
+	static const GLuint INSTANCE_COLOR = 2;
+
+	Sphere mesh;
+	size_t capacity = 0;
+
+public:
+	GLuint vaoId = 0;
+	GLuint vboId = 0;
+	GLuint iboId = 0;
+	GLuint instanceVboId = 0;
+
+	SphereInstances() : mesh(1.0f, 36, 18, true) {
+		glGenVertexArrays(1, &vaoId);
+		glBindVertexArray(vaoId);
+
+		// Mesh, shared by every instance
+		glGenBuffers(1, &vboId);
+		glBindBuffer(GL_ARRAY_BUFFER, vboId);
+		glBufferData(GL_ARRAY_BUFFER, mesh.getInterleavedVertexSize(), mesh.getInterleavedVertices(), GL_STATIC_DRAW);
+
+		glGenBuffers(1, &iboId);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.getIndexSize(), mesh.getIndices(), GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(MESH_POSITION);
+		glVertexAttribPointer(MESH_POSITION, 3, GL_FLOAT, false, mesh.getInterleavedStride(), (void*)0);
+
+		// One SphereInstance per instance
+		glGenBuffers(1, &instanceVboId);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVboId);
+
+		const GLsizei stride = sizeof(SphereInstance);
+		glEnableVertexAttribArray(INSTANCE_PLACEMENT);
+		glVertexAttribPointer(INSTANCE_PLACEMENT, 4, GL_FLOAT, false, stride, (void*)offsetof(SphereInstance, position));
+		glVertexAttribDivisor(INSTANCE_PLACEMENT, 1);
+		glEnableVertexAttribArray(INSTANCE_COLOR);
+		glVertexAttribPointer(INSTANCE_COLOR, 3, GL_FLOAT, false, stride, (void*)offsetof(SphereInstance, color));
+		glVertexAttribDivisor(INSTANCE_COLOR, 1);
+
+		// The element buffer stays bound to the VAO
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	~SphereInstances() {
+		glDeleteVertexArrays(1, &vaoId);
+		glDeleteBuffers(1, &vboId);
+		glDeleteBuffers(1, &iboId);
+		glDeleteBuffers(1, &instanceVboId);
+	}
+
+	SphereInstances(const SphereInstances&) = delete;
+	SphereInstances& operator=(const SphereInstances&) = delete;
+
+	// n instances, contiguous, e.g. the dense array of a ComponentArray<SphereInstance>
+	void draw(const SphereInstance* instances, size_t n) {
+		if (n == 0) return;
+
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVboId);
+		if (n > capacity) {
+			glBufferData(GL_ARRAY_BUFFER, n * sizeof(SphereInstance), instances, GL_STREAM_DRAW);
+			capacity = n;
+		}
+		else {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, n * sizeof(SphereInstance), instances);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindVertexArray(vaoId);
+		glDrawElementsInstanced(GL_TRIANGLES, mesh.getIndexCount(), GL_UNSIGNED_INT, 0, static_cast<GLsizei>(n));
+		glBindVertexArray(0);
+	}
+};
+
+#endif
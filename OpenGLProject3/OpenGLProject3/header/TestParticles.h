@@ -0,0 +1,142 @@
+#ifndef TESTPARTICLES_H
+#define TESTPARTICLES_H
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <GravityKernel.h>
+#include <ThreadPool.h>
+
+// Massless test particles (asteroids, comets). They are pulled by the massive
+// bodies but pull on nothing, so a step costs O(N*M) for N particles and M
+// massive bodies instead of O((N+M)^2). Stored as structure-of-arrays like
+// BodySystem and processed in independent batches, in SI units.
+class TestParticles {
+public:
+	// Particles per parallel batch
+	static const size_t BATCH = 4096;
+
+	// Particles per tile inside a batch, small enough that the tile stays in L1
+	static const size_t TILE = 256;
+
+	std::vector<double> x, y, z;
+	std::vector<double> vx, vy, vz;
+	std::vector<double> ax, ay, az;
+
+	// Mixed precision is plenty for particles and runs on the SIMD particle
+	// kernels, several times the throughput of the double loop
+	ForcePrecision precision = ForcePrecision::Double;
+
+	size_t size() const {
+		return x.size();
+	}
+
+	void reserve(size_t count) {
+		x.reserve(count); y.reserve(count); z.reserve(count);
+		vx.reserve(count); vy.reserve(count); vz.reserve(count);
+		ax.reserve(count); ay.reserve(count); az.reserve(count);
+	}
+
+	size_t addParticle(double px, double py, double pz, double pvx, double pvy, double pvz) {
+		x.push_back(px); y.push_back(py); z.push_back(pz);
+		vx.push_back(pvx); vy.push_back(pvy); vz.push_back(pvz);
+		ax.push_back(0.0); ay.push_back(0.0); az.push_back(0.0);
+		return x.size() - 1;
+	}
+
+	// Run body(batchBegin, batchEnd) over all particles, on the pool when there is one
+	template <class F>
+	void forBatches(ThreadPool* pool, F body) const {
+		const size_t n = size();
+		if (pool)
+			pool->parallelFor(0, n, BATCH, body);
+		else
+			for (size_t b = 0; b < n; b += BATCH) body(b, std::min(n, b + BATCH));
+	}
+
+	// Accelerations from m sources at (sx, sy, sz) with gm = G * mass. The
+	// particles are the inner loop, so it runs over contiguous arrays and
+	// vectorizes; the cutoff is a select, not a branch. kernel picks the SIMD
+	// particle kernel of the mixed-precision pass.
+	void computeAccelerations(const double* sx, const double* sy, const double* sz, const double* gm,
+		size_t m, ThreadPool* pool, GravityKernel kernel) {
+		if (precision == ForcePrecision::Mixed) {
+			sources.prepare(sx, sy, sz, gm, m);
+			computeAccelerationsMixed(pool, kernel);
+			return;
+		}
+
+		forBatches(pool, [&](size_t begin, size_t end) {
+			for (size_t tile = begin; tile < end; tile += TILE) {
+				const size_t tileEnd = std::min(end, tile + TILE);
+				double* tx = x.data(); double* ty = y.data(); double* tz = z.data();
+				double* accX = ax.data(); double* accY = ay.data(); double* accZ = az.data();
+
+				for (size_t i = tile; i < tileEnd; i++) {
+					accX[i] = 0.0; accY[i] = 0.0; accZ[i] = 0.0;
+				}
+
+				for (size_t j = 0; j < m; j++) {
+					const double xj = sx[j], yj = sy[j], zj = sz[j], gmj = gm[j];
+					for (size_t i = tile; i < tileEnd; i++) {
+						double dx = xj - tx[i];
+						double dy = yj - ty[i];
+						double dz = zj - tz[i];
+						double distSq = dx * dx + dy * dy + dz * dz;
+						double invDist = 1.0 / std::sqrt(distSq);
+						double s = distSq < GRAVITY_CUTOFF_SQ ? 0.0 : gmj * invDist * invDist * invDist;
+						accX[i] += dx * s;
+						accY[i] += dy * s;
+						accZ[i] += dz * s;
+					}
+				}
+			}
+		});
+	}
+
+	// Mixed precision through the particle kernels. Each tile's positions are
+	// converted to the sources' float frame once, the kernel keeps the particles
+	// in its SIMD lanes and sums every MIXED_BLOCK sources in float.
+	void computeAccelerationsMixed(ThreadPool* pool, GravityKernel kernel) {
+		forBatches(pool, [&](size_t begin, size_t end) {
+			float localX[TILE], localY[TILE], localZ[TILE];
+			for (size_t tile = begin; tile < end; tile += TILE) {
+				const size_t count = std::min(end, tile + TILE) - tile;
+				for (size_t i = 0; i < count; i++) {
+					localX[i] = sources.localX(x[tile + i]);
+					localY[i] = sources.localY(y[tile + i]);
+					localZ[i] = sources.localZ(z[tile + i]);
+				}
+				runParticleKernelMixed(kernel, sources, localX, localY, localZ, count,
+					ax.data() + tile, ay.data() + tile, az.data() + tile);
+			}
+		});
+	}
+
+	void drift(double dt, ThreadPool* pool) {
+		forBatches(pool, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				x[i] += vx[i] * dt;
+				y[i] += vy[i] * dt;
+				z[i] += vz[i] * dt;
+			}
+		});
+	}
+
+	void kick(double dt, ThreadPool* pool) {
+		forBatches(pool, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				vx[i] += ax[i] * dt;
+				vy[i] += ay[i] * dt;
+				vz[i] += az[i] * dt;
+			}
+		});
+	}
+
+private:
+	// Float copy of the sources for the mixed-precision pass
+	MixedPrecisionSources sources;
+};
+
+#endif
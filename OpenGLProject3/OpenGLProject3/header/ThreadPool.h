@@ -0,0 +1,182 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+// Work-stealing pool for data-parallel loops. A loop is cut into fixed chunks
+// of grain iterations. Every thread starts on its own contiguous share of the
+// chunks and, once that runs dry, steals from the far end of the others.
+// Chunk boundaries depend only on the range and grain, never on the thread
+// count, so anything computed per chunk (and reductions combined in chunk
+// order) is bit-identical no matter how many threads ran it.
+class ThreadPool {
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<size_t> chunks;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+	std::mutex jobMutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobDone;
+	unsigned long long generation = 0;
+	bool stopping = false;
+
+	// Current job, only changed while no chunks are queued
+	std::function<void(size_t, size_t)> jobBody;
+	size_t jobBegin = 0;
+	size_t jobEnd = 0;
+	size_t jobGrain = 1;
+	std::atomic<size_t> remaining{ 0 };
+
+	bool popOwn(size_t self, size_t& chunk) {
+		WorkerQueue& queue = *queues[self];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.chunks.empty()) return false;
+		chunk = queue.chunks.front();
+		queue.chunks.pop_front();
+		return true;
+	}
+
+	bool steal(size_t self, size_t& chunk) {
+		for (size_t k = 1; k < queues.size(); k++) {
+			WorkerQueue& queue = *queues[(self + k) % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.chunks.empty()) continue;
+			chunk = queue.chunks.back();
+			queue.chunks.pop_back();
+			return true;
+		}
+		return false;
+	}
+
+	// Run chunks until none are left anywhere
+	void drain(size_t self) {
+		size_t chunk;
+		while (popOwn(self, chunk) || steal(self, chunk)) {
+			size_t b = jobBegin + chunk * jobGrain;
+			size_t e = std::min(jobEnd, b + jobGrain);
+			jobBody(b, e);
+
+			if (remaining.fetch_sub(1) == 1) {
+				std::lock_guard<std::mutex> lock(jobMutex);
+				jobDone.notify_all();
+			}
+		}
+	}
+
+	void workerLoop(size_t self) {
+		unsigned long long seen = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(jobMutex);
+				jobReady.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping) return;
+				seen = generation;
+			}
+			drain(self);
+		}
+	}
+
+public:
+	// threadCount includes the calling thread, which works on every loop too
+	explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency()) {
+		if (threadCount == 0) threadCount = 1;
+		for (size_t i = 0; i < threadCount; i++) {
+			queues.push_back(std::make_unique<WorkerQueue>());
+		}
+		for (size_t i = 1; i < threadCount; i++) {
+			workers.emplace_back(&ThreadPool::workerLoop, this, i);
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			stopping = true;
+		}
+		jobReady.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t threadCount() const {
+		return queues.size();
+	}
+
+	// Call body(chunkBegin, chunkEnd) for every chunk of [begin, end) and wait for all of them
+	void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) {
+		if (end <= begin) return;
+		if (grain == 0) grain = 1;
+		const size_t chunkCount = (end - begin + grain - 1) / grain;
+
+		if (queues.size() == 1 || chunkCount == 1) {
+			for (size_t c = 0; c < chunkCount; c++) {
+				size_t b = begin + c * grain;
+				body(b, std::min(end, b + grain));
+			}
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			jobBody = body;
+			jobBegin = begin;
+			jobEnd = end;
+			jobGrain = grain;
+			remaining.store(chunkCount);
+
+			// Contiguous share per thread, so neighbouring chunks usually stay on one core
+			const size_t threads = queues.size();
+			for (size_t t = 0; t < threads; t++) {
+				size_t first = chunkCount * t / threads;
+				size_t last = chunkCount * (t + 1) / threads;
+				std::lock_guard<std::mutex> queueLock(queues[t]->mutex);
+				for (size_t c = first; c < last; c++) queues[t]->chunks.push_back(c);
+			}
+			generation++;
+		}
+		jobReady.notify_all();
+
+		drain(0);
+
+		std::unique_lock<std::mutex> lock(jobMutex);
+		jobDone.wait(lock, [&] { return remaining.load() == 0; });
+	}
+
+	// Sum chunk(b, e) over fixed chunks of [begin, end). Partial results are
+	// combined in chunk order, so the total does not depend on the thread count.
+	template <class T, class F>
+	T parallelReduce(size_t begin, size_t end, size_t grain, T init, F chunk) {
+		if (end <= begin) return init;
+		if (grain == 0) grain = 1;
+		const size_t chunkCount = (end - begin + grain - 1) / grain;
+
+		std::vector<T> partial(chunkCount, T());
+		parallelFor(begin, end, grain, [&](size_t b, size_t e) {
+			partial[(b - begin) / grain] = chunk(b, e);
+		});
+
+		T total = init;
+		for (const T& value : partial) total += value;
+		return total;
+	}
+};
+
+#endif
@@ -216,6 +216,31 @@ public:
 		updateBuffers();
 	}
 
+	// Ring contents as 6 floats per vertex (position, texCoord, visibility), for checkpoints
+	void exportState(int& used, glm::vec3& last, std::vector<float>& out) const {
+		used = segmentsUsed;
+		last = lastSegmentPosition;
+		out.resize(vertices.size() * 6);
+		for (size_t i = 0; i < vertices.size(); i++) {
+			const TrailVertex& v = vertices[i];
+			float* f = &out[i * 6];
+			f[0] = v.position.x; f[1] = v.position.y; f[2] = v.position.z;
+			f[3] = v.texCoord.x; f[4] = v.texCoord.y;
+			f[5] = v.visibility;
+		}
+	}
+
+	void importState(int used, const glm::vec3& last, const float* data, size_t vertexCount) {
+		size_t count = std::min(vertexCount, vertices.size());
+		for (size_t i = 0; i < count; i++) {
+			const float* f = &data[i * 6];
+			vertices[i] = { glm::vec3(f[0], f[1], f[2]), glm::vec2(f[3], f[4]), f[5] };
+		}
+		segmentsUsed = std::min(used, static_cast<int>(count / 2));
+		lastSegmentPosition = last;
+		updateBuffers();
+	}
+
 	void fillIndexBuffer() {
 		for (int i = 0; i < segments - 1; i++) {
 			indices.push_back(0 + i * 2);
@@ -249,10 +274,8 @@ public:
 
 		glBindVertexArray(vaoId);
 
-		glUniform3f(glGetUniformLocation(shader.ID, "ourColor"), color.r, color.g, color.b);
-
-		glm::mat4 model = glm::mat4(1.0f);
-		glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, glm::value_ptr(model));
+		shader.setVec3(Uniform::Color, color);
+		shader.setMat4(Uniform::Model, glm::mat4(1.0f));
 
 		int indexCount = segmentsUsed * 6;  // Each segment = 2 triangles = 6 indices
 		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
@@ -0,0 +1,110 @@
+#ifndef UNITS_H
+#define UNITS_H
+
+#include <ratio>
+
+// Compile-time units. A Quantity is a double tagged with the exponents of
+// length, mass and time and with the size of its unit relative to SI as a
+// std::ratio, in the spirit of std::chrono::duration. Adding quantities of
+// different dimensions does not compile, and changing units is a single
+// constexpr multiply.
+//
+// The physics core (BodySystem, the integrators and kernels) keeps plain SI
+// doubles; these types mark where values enter and leave it, so there is
+// exactly one conversion at each boundary and none inside a step.
+template <class From, class To>
+constexpr double unitFactor() {
+	return (static_cast<double>(From::num) * static_cast<double>(To::den))
+		/ (static_cast<double>(From::den) * static_cast<double>(To::num));
+}
+
+template <int L, int M, int T, class Scale = std::ratio<1>>
+class Quantity {
+private:
+	double amount = 0.0;
+
+public:
+	using scale = Scale;
+
+	constexpr Quantity() {}
+
+	constexpr explicit Quantity(double amount) : amount(amount) {}
+
+	// Same dimension in another unit
+	template <class OtherScale>
+	constexpr Quantity(const Quantity<L, M, T, OtherScale>& other)
+		: amount(other.value() * unitFactor<OtherScale, Scale>()) {}
+
+	// Amount in this quantity's own unit
+	constexpr double value() const {
+		return amount;
+	}
+
+	// Amount in SI base units
+	constexpr double si() const {
+		return amount * unitFactor<Scale, std::ratio<1>>();
+	}
+
+	constexpr Quantity operator-() const { return Quantity(-amount); }
+	constexpr Quantity& operator+=(Quantity other) { amount += other.amount; return *this; }
+	constexpr Quantity& operator-=(Quantity other) { amount -= other.amount; return *this; }
+	constexpr Quantity& operator*=(double factor) { amount *= factor; return *this; }
+	constexpr Quantity& operator/=(double factor) { amount /= factor; return *this; }
+
+	friend constexpr Quantity operator+(Quantity a, Quantity b) { return Quantity(a.amount + b.amount); }
+	friend constexpr Quantity operator-(Quantity a, Quantity b) { return Quantity(a.amount - b.amount); }
+	friend constexpr Quantity operator*(Quantity a, double factor) { return Quantity(a.amount * factor); }
+	friend constexpr Quantity operator*(double factor, Quantity a) { return Quantity(a.amount * factor); }
+	friend constexpr Quantity operator/(Quantity a, double factor) { return Quantity(a.amount / factor); }
+
+	friend constexpr bool operator==(Quantity a, Quantity b) { return a.amount == b.amount; }
+	friend constexpr bool operator<(Quantity a, Quantity b) { return a.amount < b.amount; }
+	friend constexpr bool operator>(Quantity a, Quantity b) { return a.amount > b.amount; }
+	friend constexpr bool operator<=(Quantity a, Quantity b) { return a.amount <= b.amount; }
+	friend constexpr bool operator>=(Quantity a, Quantity b) { return a.amount >= b.amount; }
+};
+
+// Products and quotients are formed in SI. A ratio of the same dimension is a plain number.
+template <int L1, int M1, int T1, class S1, int L2, int M2, int T2, class S2>
+constexpr Quantity<L1 + L2, M1 + M2, T1 + T2> operator*(Quantity<L1, M1, T1, S1> a, Quantity<L2, M2, T2, S2> b) {
+	return Quantity<L1 + L2, M1 + M2, T1 + T2>(a.si() * b.si());
+}
+
+template <int L1, int M1, int T1, class S1, int L2, int M2, int T2, class S2>
+constexpr auto operator/(Quantity<L1, M1, T1, S1> a, Quantity<L2, M2, T2, S2> b) {
+	if constexpr (L1 == L2 && M1 == M2 && T1 == T2)
+		return a.si() / b.si();
+	else
+		return Quantity<L1 - L2, M1 - M2, T1 - T2>(a.si() / b.si());
+}
+
+using AU = std::ratio<149597870700>;
+
+// Meters per render unit, the scale of every position handed to OpenGL
+using RenderScale = std::ratio<10000000000>;
+
+using Meters = Quantity<1, 0, 0>;
+using Kilometers = Quantity<1, 0, 0, std::kilo>;
+using AstronomicalUnits = Quantity<1, 0, 0, AU>;
+using RenderUnits = Quantity<1, 0, 0, RenderScale>;
+
+using Seconds = Quantity<0, 0, 1>;
+using Days = Quantity<0, 0, 1, std::ratio<86400>>;
+using Years = Quantity<0, 0, 1, std::ratio<31557600>>;  // Julian year, 365.25 days
+
+using Kilograms = Quantity<0, 1, 0>;
+using MetersPerSecond = Quantity<1, 0, -1>;
+using MetersPerSecondSquared = Quantity<1, 0, -2>;
+using GravitationalParameter = Quantity<3, 0, -2>;  // G * mass, m^3/s^2
+using Joules = Quantity<2, 1, -2>;
+
+// Coordinate handed to OpenGL for a position in meters
+constexpr float renderCoordinate(Meters position) {
+	return static_cast<float>(RenderUnits(position).value());
+}
+
+static_assert(Seconds(Days(1.0)).value() == 86400.0, "day conversion");
+static_assert(Days(Years(1.0)).value() == 365.25, "year conversion");
+static_assert(Meters(RenderUnits(1.0)).value() == 1e10, "render scale");
+
+#endif
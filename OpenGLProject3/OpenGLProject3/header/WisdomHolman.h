@@ -0,0 +1,389 @@
+#ifndef WISDOMHOLMAN_H
+#define WISDOMHOLMAN_H
+
+#include <Integrator.h>
+#include <BodySystem.h>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+// Stumpff functions c0..c3 of z. |z| is reduced by quartering until the series
+// is accurate, then brought back with the doubling identities, which avoids the
+// cancellation of the closed forms near zero.
+inline void stumpffFunctions(double z, double& c0, double& c1, double& c2, double& c3) {
+	int n = 0;
+	while (std::abs(z) > 0.1) {
+		z *= 0.25;
+		n++;
+	}
+
+	c3 = (1.0 - z / 20.0 * (1.0 - z / 42.0 * (1.0 - z / 72.0 * (1.0 - z / 110.0 * (1.0 - z / 156.0))))) / 6.0;
+	c2 = (1.0 - z / 12.0 * (1.0 - z / 30.0 * (1.0 - z / 56.0 * (1.0 - z / 90.0 * (1.0 - z / 132.0))))) / 2.0;
+	c1 = 1.0 - z * c3;
+	c0 = 1.0 - z * c2;
+
+	for (; n > 0; n--) {
+		c3 = (c2 + c0 * c3) * 0.25;
+		c2 = c1 * c1 * 0.5;
+		c1 = c0 * c1;
+		c0 = 2.0 * c0 * c0 - 1.0;
+	}
+}
+
+// Advance a two-body orbit with gravitational parameter mu by dt along the exact
+// Kepler solution, using universal variables so elliptic, parabolic and hyperbolic
+// orbits are handled alike. Solved with the Laguerre-Conway iteration.
+inline void keplerDrift(double mu, double& x, double& y, double& z,
+	double& vx, double& vy, double& vz, double dt) {
+	const double r0 = std::sqrt(x * x + y * y + z * z);
+
+	// No orbit to follow for a body sitting on the centre, such as the
+	// remnant of a body merged into it
+	if (r0 == 0.0) return;
+	const double v2 = vx * vx + vy * vy + vz * vz;
+	const double eta0 = x * vx + y * vy + z * vz;
+	const double beta = 2.0 * mu / r0 - v2;
+	const double zeta0 = mu - beta * r0;
+
+	// Whole revolutions of a bound orbit change nothing
+	if (beta > 0.0) {
+		double period = 2.0 * 3.14159265358979323846 * mu / (beta * std::sqrt(beta));
+		if (std::abs(dt) > period) dt = std::fmod(dt, period);
+	}
+
+	double s = dt / r0;
+	double g0 = 1.0, g1 = s, g2 = 0.0, g3 = 0.0;
+	double r = r0;
+
+	for (int iteration = 0; iteration < 50; iteration++) {
+		double c0, c1, c2, c3;
+		stumpffFunctions(beta * s * s, c0, c1, c2, c3);
+		g0 = c0;
+		g1 = s * c1;
+		g2 = s * s * c2;
+		g3 = s * s * s * c3;
+
+		double f = r0 * g1 + eta0 * g2 + mu * g3 - dt;
+		r = r0 * g0 + eta0 * g1 + mu * g2;
+		double fpp = eta0 * g0 + zeta0 * g1;
+
+		const double order = 5.0;
+		double disc = (order - 1.0) * (order - 1.0) * r * r - order * (order - 1.0) * f * fpp;
+		double denom = r + (r >= 0.0 ? 1.0 : -1.0) * std::sqrt(std::abs(disc));
+		double ds = -order * f / denom;
+
+		s += ds;
+		if (std::abs(ds) <= 1e-15 * std::abs(s)) break;
+	}
+
+	// Recompute with the converged value
+	double c0, c1, c2, c3;
+	stumpffFunctions(beta * s * s, c0, c1, c2, c3);
+	g0 = c0;
+	g1 = s * c1;
+	g2 = s * s * c2;
+	g3 = s * s * s * c3;
+	r = r0 * g0 + eta0 * g1 + mu * g2;
+
+	// Gauss f and g functions
+	const double f = 1.0 - mu * g2 / r0;
+	const double g = dt - mu * g3;
+	const double fdot = -mu * g1 / (r * r0);
+	const double gdot = 1.0 - mu * g2 / r;
+
+	double nx = f * x + g * vx;
+	double ny = f * y + g * vy;
+	double nz = f * z + g * vz;
+	double nvx = fdot * x + gdot * vx;
+	double nvy = fdot * y + gdot * vy;
+	double nvz = fdot * z + gdot * vz;
+
+	x = nx; y = ny; z = nz;
+	vx = nvx; vy = nvy; vz = nvz;
+}
+
+// Wisdom-Holman mixed-variable symplectic map in democratic heliocentric
+// coordinates (heliocentric positions, barycentric velocities). Orbits around
+// the dominant body are advanced exactly by keplerDrift, so the step only has
+// to resolve the small body-body perturbations applied as kicks:
+//   interaction kick dt/2, jump dt/2, Kepler drift dt, jump dt/2, interaction kick dt/2
+// The closing kick of a step and the opening kick of the next see the same
+// positions, so the body-body accelerations are kept and reused, one pair pass
+// per step, unless the bodies were changed in between.
+// The dominant body is the most massive one in the system. Test particles take
+// the same map; having no mass they add nothing to the jump.
+class WisdomHolmanIntegrator : public Integrator {
+private:
+	// Heliocentric positions and barycentric velocities, index matches BodySystem
+	std::vector<double> qx, qy, qz;
+	std::vector<double> px, py, pz;
+
+	// Body-body accelerations at the positions of the last interaction kick
+	std::vector<double> kx, ky, kz;
+
+	// Positions and masses the bodies were left with by the last step. When the
+	// next step starts from exactly these, kx/ky/kz still hold its opening kick.
+	// A collision, edit or seek in between changes them and the kick is recomputed.
+	std::vector<double> keptX, keptY, keptZ, keptMass;
+	bool kickKept = false;
+	size_t keptCentral = 0;
+	ForceModel keptModel = ForceModel::Newtonian;
+	double keptSoftening = 0.0;
+
+	bool canReuseKick(const BodySystem& bodies) const {
+		return kickKept && keptCentral == central && keptModel == bodies.forceModel
+			&& keptSoftening == bodies.softening
+			&& keptMass.size() == bodies.size()
+			&& std::equal(keptMass.begin(), keptMass.end(), bodies.mass.begin())
+			&& std::equal(keptX.begin(), keptX.end(), bodies.x.begin())
+			&& std::equal(keptY.begin(), keptY.end(), bodies.y.begin())
+			&& std::equal(keptZ.begin(), keptZ.end(), bodies.z.begin());
+	}
+
+	void keepKick(const BodySystem& bodies) {
+		keptX = bodies.x; keptY = bodies.y; keptZ = bodies.z;
+		keptMass = bodies.mass;
+		keptCentral = central;
+		keptModel = bodies.forceModel;
+		keptSoftening = bodies.softening;
+		kickKept = true;
+	}
+
+	// Mass and G * mass of the perturbers for the interaction and particle kicks,
+	// zero for the central body
+	std::vector<double> perturberMass;
+	std::vector<double> perturberGM;
+
+	size_t central = 0;
+
+	// Bodies per parallel chunk of the Kepler drift, each costs a root solve
+	static const size_t KEPLER_GRAIN = 64;
+
+	size_t findCentral(const BodySystem& bodies) const {
+		size_t best = 0;
+		for (size_t i = 1; i < bodies.size(); i++) {
+			if (bodies.mass[i] > bodies.mass[best]) best = i;
+		}
+		return best;
+	}
+
+	// Body-body kick under the system's force model, from kx/ky/kz as they are
+	// when evaluate is false
+	void interactionKick(BodySystem& bodies, double dt, bool evaluate) {
+		switch (bodies.forceModel) {
+		case ForceModel::Plummer: interactionKick(bodies, PlummerForce(bodies.softening), dt, evaluate); break;
+		case ForceModel::PostNewtonian: interactionKick(bodies, PostNewtonianForce(), dt, evaluate); break;
+		default: interactionKick(bodies, NewtonianForce(), dt, evaluate); break;
+		}
+	}
+
+	// Body-body accelerations in heliocentric positions, the central body excluded
+	// by giving it zero mass. They go through the system's solver, kernel, precision
+	// and pool like any other force pass. Softening only applies between the
+	// perturbers, the Kepler drift stays a point mass orbit. The post-Newtonian
+	// term of the central body is a kick as well, with the heliocentric velocity
+	// p_i + sum m_j p_j / m_central. It depends on the momenta, so it is added
+	// on every kick and never kept.
+	template <class Model>
+	void interactionKick(BodySystem& bodies, const Model& model, double dt, bool evaluate) {
+		const size_t n = bodies.size();
+		const double G = BodySystem::G;
+		if (evaluate) {
+			bodies.computeAccelerationsAt(model, qx.data(), qy.data(), qz.data(),
+				perturberMass.data(), perturberGM.data(), kx.data(), ky.data(), kz.data());
+			kx[central] = 0.0; ky[central] = 0.0; kz[central] = 0.0;
+		}
+
+		double mu = 0.0, cvx = 0.0, cvy = 0.0, cvz = 0.0;
+		if constexpr (Model::POST_NEWTONIAN) {
+			double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+			for (size_t i = 0; i < n; i++) {
+				if (i == central) continue;
+				sumX += bodies.mass[i] * px[i];
+				sumY += bodies.mass[i] * py[i];
+				sumZ += bodies.mass[i] * pz[i];
+			}
+			mu = G * bodies.mass[central];
+			cvx = sumX / bodies.mass[central]; cvy = sumY / bodies.mass[central]; cvz = sumZ / bodies.mass[central];
+		}
+
+		bodies.forRange(0, n, BodySystem::UPDATE_GRAIN, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				double ax = kx[i], ay = ky[i], az = kz[i];
+				if constexpr (Model::POST_NEWTONIAN) {
+					if (i != central)
+						addPostNewtonian(mu, qx[i], qy[i], qz[i], px[i] + cvx, py[i] + cvy, pz[i] + cvz, ax, ay, az);
+				}
+				px[i] += ax * dt;
+				py[i] += ay * dt;
+				pz[i] += az * dt;
+			}
+		});
+	}
+
+	// Particles are kept in heliocentric positions and barycentric velocities
+	// in place during the step, and pulled by the perturbers only
+	void particleKick(BodySystem& bodies, double dt) {
+		TestParticles& particles = bodies.particles;
+		if (particles.size() == 0) return;
+		particles.computeAccelerations(qx.data(), qy.data(), qz.data(), perturberGM.data(), bodies.size(), bodies.pool, bodies.gravityKernel);
+		particles.kick(dt, bodies.pool);
+	}
+
+	// Drift of the heliocentric positions caused by the central body's momentum
+	void jump(BodySystem& bodies, double dt) {
+		const size_t n = bodies.size();
+		double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+		for (size_t i = 0; i < n; i++) {
+			if (i == central) continue;
+			sumX += bodies.mass[i] * px[i];
+			sumY += bodies.mass[i] * py[i];
+			sumZ += bodies.mass[i] * pz[i];
+		}
+
+		double scale = dt / bodies.mass[central];
+		for (size_t i = 0; i < n; i++) {
+			if (i == central) continue;
+			qx[i] += sumX * scale;
+			qy[i] += sumY * scale;
+			qz[i] += sumZ * scale;
+		}
+
+		TestParticles& particles = bodies.particles;
+		particles.forBatches(bodies.pool, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				particles.x[i] += sumX * scale;
+				particles.y[i] += sumY * scale;
+				particles.z[i] += sumZ * scale;
+			}
+		});
+	}
+
+public:
+	WisdomHolmanIntegrator() {
+		// Only the perturbations have to be resolved, so steps can be long
+		maxSubstep = Days(16.0);
+	}
+
+	const char* name() const override { return "wh"; }
+	int evaluationsPerStep() const override { return 1; }
+
+	void step(BodySystem& bodies, double dt) override {
+		const size_t n = bodies.size();
+		if (n < 2 && bodies.particles.size() == 0) {
+			bodies.drift(dt);
+			return;
+		}
+
+		central = findCentral(bodies);
+		const bool reuseKick = canReuseKick(bodies);
+		qx.resize(n); qy.resize(n); qz.resize(n);
+		px.resize(n); py.resize(n); pz.resize(n);
+		kx.resize(n); ky.resize(n); kz.resize(n);
+
+		// Barycenter, which moves uniformly and is added back at the end
+		double totalMass = 0.0;
+		double cmx = 0.0, cmy = 0.0, cmz = 0.0;
+		double cvx = 0.0, cvy = 0.0, cvz = 0.0;
+		for (size_t i = 0; i < n; i++) {
+			double m = bodies.mass[i];
+			totalMass += m;
+			cmx += m * bodies.x[i]; cmy += m * bodies.y[i]; cmz += m * bodies.z[i];
+			cvx += m * bodies.vx[i]; cvy += m * bodies.vy[i]; cvz += m * bodies.vz[i];
+		}
+		cmx /= totalMass; cmy /= totalMass; cmz /= totalMass;
+		cvx /= totalMass; cvy /= totalMass; cvz /= totalMass;
+
+		// To democratic heliocentric coordinates
+		for (size_t i = 0; i < n; i++) {
+			qx[i] = bodies.x[i] - bodies.x[central];
+			qy[i] = bodies.y[i] - bodies.y[central];
+			qz[i] = bodies.z[i] - bodies.z[central];
+			px[i] = bodies.vx[i] - cvx;
+			py[i] = bodies.vy[i] - cvy;
+			pz[i] = bodies.vz[i] - cvz;
+		}
+
+		perturberMass.resize(n);
+		perturberGM.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			perturberMass[i] = (i == central) ? 0.0 : bodies.mass[i];
+			perturberGM[i] = BodySystem::G * perturberMass[i];
+		}
+
+		TestParticles& particles = bodies.particles;
+		const double startX = bodies.x[central], startY = bodies.y[central], startZ = bodies.z[central];
+		particles.forBatches(bodies.pool, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				particles.x[i] -= startX; particles.y[i] -= startY; particles.z[i] -= startZ;
+				particles.vx[i] -= cvx; particles.vy[i] -= cvy; particles.vz[i] -= cvz;
+			}
+		});
+
+		const double mu = BodySystem::G * bodies.mass[central];
+
+		interactionKick(bodies, 0.5 * dt, !reuseKick);
+		particleKick(bodies, 0.5 * dt);
+		jump(bodies, 0.5 * dt);
+		// Every orbit on its own, split over the pool like the particles'
+		bodies.forRange(0, n, KEPLER_GRAIN, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				if (i == central) continue;
+				keplerDrift(mu, qx[i], qy[i], qz[i], px[i], py[i], pz[i], dt);
+			}
+		});
+		particles.forBatches(bodies.pool, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				keplerDrift(mu, particles.x[i], particles.y[i], particles.z[i],
+					particles.vx[i], particles.vy[i], particles.vz[i], dt);
+			}
+		});
+		jump(bodies, 0.5 * dt);
+		interactionKick(bodies, 0.5 * dt, true);
+		particleKick(bodies, 0.5 * dt);
+
+		// Back to the inertial frame: central body from the barycenter condition
+		double sumQx = 0.0, sumQy = 0.0, sumQz = 0.0;
+		double sumPx = 0.0, sumPy = 0.0, sumPz = 0.0;
+		for (size_t i = 0; i < n; i++) {
+			if (i == central) continue;
+			double m = bodies.mass[i];
+			sumQx += m * qx[i]; sumQy += m * qy[i]; sumQz += m * qz[i];
+			sumPx += m * px[i]; sumPy += m * py[i]; sumPz += m * pz[i];
+		}
+
+		double centralX = cmx + cvx * dt - sumQx / totalMass;
+		double centralY = cmy + cvy * dt - sumQy / totalMass;
+		double centralZ = cmz + cvz * dt - sumQz / totalMass;
+
+		for (size_t i = 0; i < n; i++) {
+			if (i == central) continue;
+			bodies.x[i] = centralX + qx[i];
+			bodies.y[i] = centralY + qy[i];
+			bodies.z[i] = centralZ + qz[i];
+			bodies.vx[i] = cvx + px[i];
+			bodies.vy[i] = cvy + py[i];
+			bodies.vz[i] = cvz + pz[i];
+		}
+
+		bodies.x[central] = centralX;
+		bodies.y[central] = centralY;
+		bodies.z[central] = centralZ;
+		bodies.vx[central] = cvx - sumPx / bodies.mass[central];
+		bodies.vy[central] = cvy - sumPy / bodies.mass[central];
+		bodies.vz[central] = cvz - sumPz / bodies.mass[central];
+
+		particles.forBatches(bodies.pool, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				particles.x[i] += centralX; particles.y[i] += centralY; particles.z[i] += centralZ;
+				particles.vx[i] += cvx; particles.vy[i] += cvy; particles.vz[i] += cvz;
+			}
+		});
+
+		bodies.accelerationsValid = false;
+		keepKick(bodies);
+	}
+};
+
+#endif
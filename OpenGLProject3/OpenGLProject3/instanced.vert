@@ -0,0 +1,18 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec4 aPlacement; // centre xyz, radius w
+layout(location = 2) in vec3 aColor;
+
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+
+out vec3 instanceColor;
+
+void main()
+{
+    instanceColor = aColor;
+    gl_Position = projection * view * vec4(aPos * aPlacement.w + aPlacement.xyz, 1.0);
+}
\ No newline at end of file
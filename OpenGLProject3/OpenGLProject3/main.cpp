@@ -6,8 +6,18 @@
 #include <iostream>
 #include <Sphere.h>
 #include <Shader.h>
+#include <CameraBuffer.h>
 #include <Camera.h>
+#include <BodySystem.h>
+#include <IntegratorFactory.h>
+#include <IntegratorBenchmark.h>
+#include <SolverBenchmark.h>
 #include <Planets.h>
+#include <BodyCatalog.h>
+#include <ChebyshevTable.h>
+#include <ParticleCloud.h>
+#include <SimulationThread.h>
+#include <KeplerEphemeris.h>
 #include <HandCursor.h>
 
 
@@ -23,8 +33,148 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 float deltaTime = 0.0f;	// Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 
+// Simulated seconds per real second
+const double TIME_SCALE = 10000000.0;
+
+// How far [ and ] jump in time, on rails and through the history of an integrated run
+const double RAILS_SEEK_YEARS = 1000.0;
+const double HISTORY_SEEK_YEARS = 1.0;
+
+
+int main(int argc, char** argv) {
+	// Command line options
+	IntegratorType integratorType = IntegratorType::VelocityVerlet;
+	double substepDays = 1.0;
+	ForceSolver forceSolver = ForceSolver::Direct;
+	double theta = 0.5;
+	GravityKernel gravityKernel = detectGravityKernel();
+	ForcePrecision forcePrecision = ForcePrecision::Double;
+	ForceModel forceModel = ForceModel::Newtonian;
+	double softening = 1e7;
+	size_t threadCount = std::thread::hardware_concurrency();
+	size_t particleCount = 0;
+	double tickRate = 120.0;
+	std::string checkpointPath = "checkpoint.bin";
+	std::string restorePath;
+	double monitorDays = 0.0;
+	bool detectCollisions = false;
+	CollisionResponse collisionResponse = CollisionResponse::Merge;
+	bool onRails = false;
+	double historyDays = 30.0;
+	size_t historyMegabytes = 256;
+	double timeScale = TIME_SCALE;
+	std::string catalogPath;
+	std::string ephemerisPath;
+	double epoch = J2000_JULIAN_DATE;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.rfind("--integrator=", 0) == 0) {
+			if (!parseIntegratorType(arg.substr(13), integratorType))
+				std::cout << "Unknown integrator " << arg.substr(13) << ", using verlet" << std::endl;
+		}
+		else if (arg.rfind("--substep=", 0) == 0) {
+			substepDays = std::stod(arg.substr(10));
+		}
+		else if (arg == "--barnes-hut") {
+			forceSolver = ForceSolver::BarnesHut;
+		}
+		else if (arg.rfind("--theta=", 0) == 0) {
+			theta = std::stod(arg.substr(8));
+		}
+		else if (arg.rfind("--kernel=", 0) == 0) {
+			GravityKernel requested;
+			if (!parseGravityKernel(arg.substr(9), requested))
+				std::cout << "Unknown kernel " << arg.substr(9) << ", using " << gravityKernelName(gravityKernel) << std::endl;
+			else if (!gravityKernelSupported(requested))
+				std::cout << "This CPU cannot run " << arg.substr(9) << ", using " << gravityKernelName(gravityKernel) << std::endl;
+			else
+				gravityKernel = requested;
+		}
+		else if (arg == "--precision=mixed") {
+			forcePrecision = ForcePrecision::Mixed;
+		}
+		else if (arg == "--precision=double") {
+			forcePrecision = ForcePrecision::Double;
+		}
+		else if (arg.rfind("--force=", 0) == 0) {
+			if (!parseForceModel(arg.substr(8), forceModel))
+				std::cout << "Unknown force model " << arg.substr(8) << ", using newtonian" << std::endl;
+		}
+		else if (arg.rfind("--softening=", 0) == 0) {
+			softening = std::stod(arg.substr(12));
+		}
+		else if (arg.rfind("--threads=", 0) == 0) {
+			threadCount = std::stoul(arg.substr(10));
+		}
+		else if (arg.rfind("--particles=", 0) == 0) {
+			particleCount = std::stoul(arg.substr(12));
+		}
+		else if (arg.rfind("--tick-rate=", 0) == 0) {
+			tickRate = std::stod(arg.substr(12));
+		}
+		else if (arg.rfind("--checkpoint=", 0) == 0) {
+			checkpointPath = arg.substr(13);
+		}
+		else if (arg.rfind("--restore=", 0) == 0) {
+			restorePath = arg.substr(10);
+		}
+		else if (arg.rfind("--collisions=", 0) == 0) {
+			if (parseCollisionResponse(arg.substr(13), collisionResponse))
+				detectCollisions = true;
+			else
+				std::cout << "Unknown collision response " << arg.substr(13) << ", collisions off" << std::endl;
+		}
+		else if (arg.rfind("--monitor-days=", 0) == 0) {
+			monitorDays = std::stod(arg.substr(15));
+		}
+		else if (arg.rfind("--catalog=", 0) == 0) {
+			catalogPath = arg.substr(10);
+		}
+		else if (arg.rfind("--ephemeris=", 0) == 0) {
+			ephemerisPath = arg.substr(12);
+		}
+		else if (arg.rfind("--epoch=", 0) == 0) {
+			epoch = std::stod(arg.substr(8));
+		}
+		else if (arg == "--rails") {
+			onRails = true;
+		}
+		else if (arg.rfind("--time-scale=", 0) == 0) {
+			timeScale = std::stod(arg.substr(13));
+		}
+		else if (arg.rfind("--history-days=", 0) == 0) {
+			historyDays = std::stod(arg.substr(15));
+		}
+		else if (arg.rfind("--history-mb=", 0) == 0) {
+			historyMegabytes = std::stoul(arg.substr(13));
+		}
+		else if (arg == "--benchmark-integrators") {
+			runIntegratorBenchmark(std::cout);
+			return 0;
+		}
+		else if (arg == "--benchmark-solvers") {
+			runSolverBenchmark(std::cout, theta);
+			return 0;
+		}
+		else if (arg == "--benchmark-kernels") {
+			runKernelBenchmark(std::cout);
+			return 0;
+		}
+		else if (arg == "--benchmark-threads") {
+			runThreadBenchmark(std::cout);
+			return 0;
+		}
+		else if (arg == "--benchmark-precision") {
+			runPrecisionBenchmark(std::cout);
+			return 0;
+		}
+		else if (arg == "--benchmark-ephemeris") {
+			runEphemerisBenchmark(std::cout);
+			return 0;
+		}
+	}
 
-int main() {
 	// Configure GLFW
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -77,37 +227,117 @@ int main() {
 	
 	// Setting up sphere-----------------------------------------------------------------
 
-	Planet sun("Sun");
-	Planet mercury("Mercury");
-	Planet venus("Venus");
-	Planet earth("Earth");
-	Planet mars("Mars");
-	Planet jupiter("Jupiter");
-	Planet saturn("Saturn");
-	Planet uranus("Uranus");
-	Planet neptune("Neptune");
-
-	std::vector<Planet*> allPlanets;
-	allPlanets.push_back(&sun);
-	allPlanets.push_back(&mercury);
-	allPlanets.push_back(&venus);
-	allPlanets.push_back(&earth);
-	allPlanets.push_back(&mars);
-	allPlanets.push_back(&jupiter);
-	allPlanets.push_back(&saturn);
-	allPlanets.push_back(&uranus);
-	allPlanets.push_back(&neptune);
+	// All body state is stored in one structure-of-arrays system
+	ThreadPool pool(threadCount);
+	BodySystem bodies;
+	bodies.pool = &pool;
+	bodies.forceSolver = forceSolver;
+	bodies.openingAngle = theta;
+	bodies.gravityKernel = gravityKernel;
+	bodies.forcePrecision = forcePrecision;
+	bodies.particles.precision = forcePrecision;
+	bodies.forceModel = forceModel;
+	bodies.softening = softening;
+
+	// Bodies come from a catalog file when one is given, the built-in solar system otherwise
+	BodyCatalog catalog;
+	if (catalogPath.empty() || !catalog.open(catalogPath)) {
+		if (!catalogPath.empty()) std::cout << "Cannot load catalog, " << catalog.error << ", using the built-in one" << std::endl;
+		catalog.useBuiltIn();
+	}
+
+	// The planets are drawn, a planet missing from the catalog keeps its built-in entry
+	auto planetData = [&](const std::string& name) {
+		size_t entry = catalog.find(name);
+		return entry == BodyCatalog::npos ? findPlanetData(name) : catalog.entry(entry);
+	};
+	BodyEntities entities;
+	PlanetScene scene;
+	for (const char* name : { "Sun", "Mercury", "Venus", "Earth", "Mars", "Jupiter", "Saturn", "Uranus", "Neptune" }) {
+		Entity entity = entities.create(bodies, planetData(name));
+		scene.add(entity, entities.data(entity), bodyRenderPosition(bodies, entities.body(entity)));
+	}
+
+	// Massless asteroid belt, pulled by the planets only
+	addAsteroidBeltParticles(bodies, particleCount);
+	ParticleCloud particleCloud;
+
+	std::unique_ptr<Integrator> integrator = makeIntegrator(integratorType);
+	integrator->maxSubstep = Days(substepDays);
+	std::cout << "Integrator: " << integrator->name() << ", substep " << substepDays << " days"
+		<< ", force " << forceModelName(forceModel) << std::endl;
+
+	// Every other catalog body only takes part in the physics, after the planets
+	for (size_t i = 0; i < catalog.size(); i++) {
+		PlanetData data = catalog.entry(i);
+		Entity planet = entities.find(data.name);
+		if (planet.valid() && scene.planets.has(planet)) continue;
+		entities.adopt(catalog.addBody(bodies, i), data);
+	}
+	if (!catalogPath.empty()) std::cout << "Catalog: " << catalog.size() << " bodies, " << bodies.size() << " in the system" << std::endl;
+
+	// Start at a real date, from the bodies' reference states at the epoch
+	double startTime = 0.0;
+	if (!ephemerisPath.empty()) {
+		ChebyshevTable ephemeris;
+		if (!ephemeris.open(ephemerisPath)) {
+			std::cout << "Cannot read ephemeris " << ephemerisPath << std::endl;
+		}
+		else {
+			startTime = julianDateToSeconds(epoch);
+			size_t set = setEphemerisStates(ephemeris, bodies, startTime, [&](size_t i) { return entities.name(i); });
+			scene.reset(entities, bodies);
+			std::cout << "Ephemeris " << ephemerisPath << " at JD " << epoch << ", " << set << " bodies set" << std::endl;
+		}
+	}
+
+	// Bodies added with Insert, or restored from a checkpoint, newest last
+	std::vector<Entity> visitors;
+
+	// Continue a saved run, the planets keep their catalog order as body indices
+	if (!restorePath.empty()) {
+		CheckpointView checkpoint;
+		if (!checkpoint.open(restorePath)) {
+			std::cout << "Cannot read checkpoint " << restorePath << std::endl;
+		}
+		else if (checkpoint.bodyCount() < entities.bodyCount()) {
+			std::cout << "Checkpoint " << restorePath << " has too few bodies" << std::endl;
+		}
+		else {
+			checkpoint.restore(bodies);
+			startTime = checkpoint.simTime();
+			// Bodies added during the saved run are not in the catalog. They are
+			// drawn like visitors; the indices of removed ones go to the next Insert.
+			scene.reset(entities, bodies);
+			for (size_t i = entities.bodyCount(); i < bodies.size(); i++) {
+				if (bodies.mass[i] == 0.0) {
+					entities.release(i);
+					continue;
+				}
+				PlanetData data = emptyCatalogEntry();
+				data.name = "Body " + std::to_string(i);
+				data.mass = bodies.mass[i];
+				data.radius = bodies.radius[i];
+				data.color = glm::vec3(1.0f, 0.4f, 0.8f);
+				Entity entity = entities.adopt(i, data);
+				scene.add(entity, data, bodyRenderPosition(bodies, i));
+				visitors.push_back(entity);
+			}
+			std::vector<size_t> order = scene.trailOrder(entities);
+			for (size_t t = 0; t < order.size(); t++) scene.trails[order[t]].restore(checkpoint, t);
+			std::cout << "Restored " << restorePath << " at day " << Days(Seconds(startTime)).value() << std::endl;
+		}
+	}
 	
 
 
 	
 	Shader ourShader("vertex.vert", "fragment.frag");
 	Shader circleShader("vertCir.vert", "fragCir.frag");
+	Shader instancedShader("instanced.vert", "instanced.frag");
 	
-	// Get uniform locations
-	int modelLoc = glGetUniformLocation(ourShader.ID, "model");
-	int viewLoc = glGetUniformLocation(ourShader.ID, "view");
-	int projectionLoc = glGetUniformLocation(ourShader.ID, "projection");
+	// View and projection for every program, uploaded once per frame
+	CameraBuffer cameraBuffer;
 
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_BLEND);
@@ -119,6 +349,33 @@ int main() {
 
 
 
+	// Physics runs on its own thread from here on, the loop below only reads snapshots
+	ConservationMonitor monitor{ Days(monitorDays) };
+	CollisionDetector collisions(collisionResponse);
+	collisions.time = startTime;
+	if (detectCollisions) integrator->collisions = &collisions;
+	SimulationThread simulation(bodies, *integrator, tickRate, timeScale, startTime);
+	if (monitorDays > 0.0) simulation.monitor = &monitor;
+
+	// Keyframes to scrub back through, replaying at most historyDays per jump
+	HistoryCache history(Days(historyDays), historyMegabytes << 20);
+	if (historyDays > 0.0 && !onRails) simulation.history = &history;
+
+	// On rails the planets keep their catalog orbits and nothing is integrated
+	KeplerEphemeris ephemeris;
+	if (onRails) {
+		ephemeris.build(bodies, startTime);
+		for (size_t k = 0; k < scene.planets.size(); k++) {
+			Entity entity = scene.planets.entity(k);
+			ephemeris.useCatalogOrbit(bodies, entities.body(entity), entities.data(entity));
+		}
+		simulation.ephemeris = &ephemeris;
+		std::cout << "On rails, " << ephemeris.bodyOrbits.size() << " body and "
+			<< ephemeris.particleOrbits.size() << " particle orbits" << std::endl;
+	}
+	simulation.start();
+	std::vector<float> particleVertices;
+
 	lastFrame = glfwGetTime();  // Initialize lastFrame before loop starts
 	// Render loop
 	while (!glfwWindowShouldClose(window)) {
@@ -135,6 +392,70 @@ int main() {
 		// Input
 		camera.processInput(window, deltaTime);
 
+		// F5 saves a checkpoint, the simulation fills in the bodies after its next tick
+		static bool checkpointKeyDown = false;
+		bool checkpointKey = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+		if (checkpointKey && !checkpointKeyDown) {
+			CheckpointData data;
+			std::vector<size_t> order = scene.trailOrder(entities);
+			data.trails.resize(order.size());
+			for (size_t t = 0; t < order.size(); t++) {
+				scene.trails[order[t]].save(data.trails[t]);
+			}
+			simulation.requestCheckpoint(checkpointPath, std::move(data));
+			std::cout << "Saving checkpoint " << checkpointPath << std::endl;
+		}
+		checkpointKeyDown = checkpointKey;
+
+		// [ and ] jump back and forward in time, free on rails, through the history otherwise
+		static bool seekKeyDown = false;
+		int seekDirection = (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+			- (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS);
+		if (seekDirection != 0 && !seekKeyDown) {
+			double years = onRails ? RAILS_SEEK_YEARS : HISTORY_SEEK_YEARS;
+			double target = simulation.latest().simTime + seekDirection * Seconds(Years(years)).value();
+			if (simulation.seek(target))
+				std::cout << "Jumping to year " << Years(Seconds(target)).value() << std::endl;
+		}
+		seekKeyDown = seekDirection != 0;
+
+		// Insert adds a visitor on a random circular orbit, Delete removes the newest one.
+		// The store picks the body index here, the simulation fills it before its next tick.
+		static bool editKeyDown = false;
+		bool insertKey = glfwGetKey(window, GLFW_KEY_INSERT) == GLFW_PRESS;
+		bool deleteKey = glfwGetKey(window, GLFW_KEY_DELETE) == GLFW_PRESS;
+		if (insertKey && !editKeyDown && !onRails) {
+			PlanetData data = findPlanetData("Mars");
+			data.name = "Visitor " + std::to_string(visitors.size() + 1);
+			data.color = glm::vec3(1.0f, 0.4f, 0.8f);
+			data.hasState = true;
+			circularOrbitState(Meters(AstronomicalUnits(1.5 + 3.5 * (rand() / (double)RAND_MAX))).value(),
+				5.0, data.position, data.velocity);
+
+			Entity entity = entities.spawn(data);
+			size_t body = entities.body(entity);
+			simulation.requestEdit([body, data, &collisions](BodySystem& system) {
+				collisions.release(body);
+				placePlanetBody(system, body, data);
+			});
+			scene.add(entity, data, glm::vec3(renderCoordinate(Meters(data.position.x)),
+				renderCoordinate(Meters(data.position.y)), renderCoordinate(Meters(data.position.z))));
+			visitors.push_back(entity);
+			std::cout << "Added " << data.name << " as body " << body << std::endl;
+		}
+		if (deleteKey && !editKeyDown && !visitors.empty()) {
+			Entity entity = visitors.back();
+			visitors.pop_back();
+			std::string name = entities.data(entity).name;
+			size_t body;
+			if (entities.destroy(entity, body)) {
+				scene.remove(entity);
+				simulation.requestEdit([body](BodySystem& system) { system.removeBody(body); });
+				std::cout << "Removed " << name << std::endl;
+			}
+		}
+		editKeyDown = insertKey || deleteKey;
+
 		// Rendering commands here
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -151,10 +472,9 @@ int main() {
 		//g;m::perspective(FOV, aspect ratio, near plane, far plane)
 		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 1280.0f / 720.0f, 0.1f, 1000.0f);
 
-		// Upload matrices to shader
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+		// Upload matrices, model to this shader and the camera to all of them
+		ourShader.setMat4(Uniform::Model, model);
+		cameraBuffer.update(view, projection);
 
 
 		static int frameCount = 0;
@@ -163,9 +483,19 @@ int main() {
 			std::cout << "Earth: (" << pos.x << ", " << pos.y << ", " << pos.z << ")" << std::endl;
 		}*/
 
-		for (Planet* planet : allPlanets) {
-			planet->draw(ourShader, allPlanets, deltaTime);
-		}
+		// Draw between the last two simulation ticks
+		const RenderSnapshot& snapshot = simulation.latest();
+		float alpha = simulation.interpolation(snapshot);
+
+		// Every planet in one draw call, then the trails and particles over them
+		scene.follow(entities, snapshot, alpha);
+		instancedShader.use();
+		scene.drawPlanets();
+
+		ourShader.use();
+		scene.drawTrails(ourShader);
+		snapshot.particlePositions(alpha, particleVertices);
+		particleCloud.draw(ourShader, particleVertices);
 
 
 		// For drawing overlay on camera view
@@ -190,7 +520,7 @@ int main() {
 		glfwPollEvents();		
 	}
 
-	
+	simulation.stop();
 	
 
 	glfwTerminate();